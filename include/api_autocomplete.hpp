@@ -1,50 +1,66 @@
 #pragma once
 
 #include <cstdint>
+#include <fstream>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "api_dictionary.hpp"
+
 namespace cord19 {
 
-// Trie-based autocomplete index.
+// Autocomplete over the segments' sorted term dictionaries.
 //
 // Notes:
 // - Terms are assumed to be single tokens (your lexicon terms are tokens).
-// - Scores rank suggestions (higher score first).
-// - Each trie node stores a small "top list" so lookup is O(|prefix|).
+// - Scores rank suggestions (higher corpus df first, then alphabetically).
+// - Prefixes of up to SHORT_PREFIX characters match too many terms to scan
+//   per request, so their top lists are computed once at build. Longer
+//   prefixes are answered by a range scan of the dictionaries.
 class AutocompleteIndex {
 public:
     void clear();
     bool empty() const;
 
-    void build(const std::unordered_map<std::string, uint32_t>& term_to_score,
+    // Index the terms of `dicts`, which must outlive this index
+    void build(std::vector<const TermDictionary*> dicts,
                size_t max_candidates_per_prefix = 10);
 
+    // Switch to `dicts` (the current ones plus `added`) and fold the added
+    // dictionaries' terms into the short-prefix lists without a full build.
+    // Only valid when no dictionary was dropped: df sums can only grow then,
+    // so a listed term can only be pushed out by one that outranks it.
+    void add_dictionaries(std::vector<const TermDictionary*> dicts,
+                          const std::vector<const TermDictionary*>& added);
+
+    // Write the short-prefix lists (what build() computes)
+    void save(std::ofstream& out) const;
+
+    // Switch to `dicts` and read lists written by save() for the same
+    // dictionaries instead of building them. False if the bytes are damaged.
+    bool load(std::vector<const TermDictionary*> dicts, ByteReader& in);
+
     // Returns full query suggestions for user_input.
     // For multi-word input, completes only the last token and preserves the prefix part.
     std::vector<std::string> suggest_query(const std::string& user_input,
                                           size_t limit = 5) const;
 
 private:
-    struct Cand {
-        uint32_t term_index = 0;
-        uint32_t score = 0;
-    };
+    static constexpr size_t SHORT_PREFIX = 2;
 
-    struct Node {
-        std::unordered_map<char, uint32_t> next;
-        std::vector<Cand> top;
+    struct Cand {
+        std::string term;
+        uint64_t score = 0;
     };
 
-    std::vector<Node> nodes_;
-    std::vector<std::string> terms_;
-    std::vector<uint32_t> scores_;
+    std::vector<const TermDictionary*> dicts_;
+    std::unordered_map<std::string, std::vector<Cand>> short_top_;
+    bool has_terms_ = false;
     size_t max_top_ = 10;
 
-    void insert_term(uint32_t term_index);
-    void update_top(std::vector<Cand>& top, const Cand& c) const;
-    bool lookup_node(const std::string& prefix_norm, uint32_t& node_id) const;
+    void update_top(std::vector<Cand>& top, std::string_view term, uint64_t score) const;
+    void scan_top(const std::string& prefix_norm, std::vector<Cand>& top) const;
     static std::string normalize_token(const std::string& s);
 };
 
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "api_autocomplete.hpp"
+#include "api_types.hpp"
+#include "semantic_embedding.hpp"
+
+namespace cord19 {
+
+// Startup snapshot of derived state (index_dir/derived/).
+//
+// Reload derives the metadata row offsets from metadata.csv, the
+// autocomplete lists from the segments and the embedding vectors from a
+// text file filtered to indexed terms. Their inputs rarely change between
+// restarts, so each result is saved in its own versioned file tagged with a
+// hash of its inputs (its key) and read back through a mapping while the
+// key still matches. A missing, stale or damaged file is rebuilt instead.
+
+// Inputs each structure of a snapshot was derived from (0 = nothing to save)
+struct DerivedKeys {
+    uint64_t metadata = 0;      // metadata.csv
+    uint64_t autocomplete = 0;  // the segment list and files
+    uint64_t embeddings = 0;    // the embeddings file and the segments filtering it
+};
+
+uint64_t metadata_key(const FileStamp& csv);
+uint64_t segments_key(const std::vector<std::string>& seg_names, const std::vector<SegmentPtr>& segments);
+uint64_t embeddings_key(const fs::path& path, const FileStamp& stamp, uint64_t segments);
+
+fs::path derived_dir(const fs::path& index_dir);
+
+// Each load returns false unless index_dir holds a readable file for `key`
+bool load_derived_metadata(const fs::path& index_dir, uint64_t key,
+                           std::unordered_map<std::string, MetaInfo>& out);
+bool load_derived_autocomplete(const fs::path& index_dir, uint64_t key,
+                               std::vector<const TermDictionary*> dicts, AutocompleteIndex& out);
+bool load_derived_embeddings(const fs::path& index_dir, uint64_t key, SemanticIndex& out);
+
+// Files are written to a temp file and renamed into place
+bool save_derived_metadata(const fs::path& index_dir, uint64_t key,
+                           const std::unordered_map<std::string, MetaInfo>& uid_to_meta, std::string& err);
+bool save_derived_autocomplete(const fs::path& index_dir, uint64_t key,
+                               const AutocompleteIndex& ac, std::string& err);
+bool save_derived_embeddings(const fs::path& index_dir, uint64_t key,
+                             const SemanticIndex& sem, std::string& err);
+
+} // namespace cord19
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "api_mmap.hpp"
+#include "lexicon_dict.hpp"
+
+namespace cord19 {
+
+// One segment's terms in sorted order (lexicon.dict).
+//
+// The mapped file is read in place: open() checks the header and the sparse
+// block index, lower_bound() binary-searches the block first terms and then
+// decodes a single front-coded block. Older segments without lexicon.dict
+// get an encoded copy of their lexicon instead (adopt()).
+class TermDictionary {
+public:
+    // Use the mapped lexicon.dict bytes (must outlive this object)
+    bool open(ByteSpan bytes, std::string& err);
+
+    // Take ownership of an encoded image (see encode_term_dictionary)
+    bool adopt(std::vector<uint8_t> bytes, std::string& err);
+
+    uint32_t size() const { return h_.term_count; }
+
+    // Forward iterator over the terms in byte order
+    class Cursor {
+    public:
+        // False once past the last term (or on a malformed block)
+        bool valid() const { return valid_; }
+
+        std::string_view term() const { return term_; }
+        uint32_t term_id() const { return term_id_; }
+        uint32_t df() const { return df_; }
+
+        void next();
+
+    private:
+        friend class TermDictionary;
+
+        const TermDictionary* dict_ = nullptr;
+        uint32_t index_ = 0;              // rank of the current term
+        const uint8_t* p_ = nullptr;      // next entry in the block
+        const uint8_t* end_ = nullptr;    // end of the block
+        std::string term_;                // decoded current term
+        uint32_t term_id_ = 0;
+        uint32_t df_ = 0;
+        bool valid_ = false;
+
+        void seek_block(uint32_t b);
+        bool decode();
+    };
+
+    Cursor begin() const;
+
+    // Cursor at the first term >= key
+    Cursor lower_bound(std::string_view key) const;
+
+private:
+    std::vector<uint8_t> owned_;  // adopted image (empty when mapped)
+    DictHeader h_{};
+    const uint32_t* block_offsets_ = nullptr;
+    const uint8_t* data_ = nullptr;
+
+    bool block_first(uint32_t b, std::string_view& out) const;
+};
+
+// Call f(term, df) for every term starting with `prefix` in any of `dicts`,
+// in sorted order and with df summed over the dictionaries holding the term.
+// Stops early when f returns false.
+void scan_prefix(const std::vector<const TermDictionary*>& dicts, std::string_view prefix,
+                 const std::function<bool(std::string_view, uint64_t)>& f);
+
+} // namespace cord19
@@ -1,40 +1,141 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <filesystem>
 #include <list>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "api_autocomplete.hpp"
+#include "api_derived.hpp"
+#include "api_metadata.hpp"
+#include "api_ram_segment.hpp"
+#include "api_segment.hpp"
 #include "api_types.hpp"
+#include "live_docs.hpp"
 #include "semantic_embedding.hpp"
+#include "thread_pool.hpp"
 
 namespace cord19 {
 
+// Retrieval strategy for Engine::search
+enum class SearchMode {
+    Exhaustive,  // term-at-a-time over every posting (exact "found")
+    Wand,        // document-at-a-time WAND; skips non-competitive docs
+    Impact       // score-at-a-time over quantized impacts (lexicon ... impacts)
+};
+
 // Cache entry structure for LRU cache with expiry
 struct CacheEntry {
     json result;
     std::list<std::string>::iterator lru_iter;
     std::chrono::steady_clock::time_point timestamp;
+    uint64_t generation = 0;  // snapshot a search result was ranked on
+    std::vector<std::string> terms;  // terms it was scored on (empty: unknown)
 };
 
-struct Engine {
-    fs::path index_dir;
+// Everything loaded from index_dir for serving queries.
+//
+// A snapshot is never modified after it is published: reload() builds a new
+// one off to the side and swaps it in, and readers keep whichever snapshot
+// they grabbed until their query finishes.
+struct IndexSnapshot {
+    // Bumped by a reload that changes the disk segments, metadata or
+    // embeddings; page cursors and cached results live for one generation
+    uint64_t generation = 0;
+
+    // Bumped on every publish, RAM adds and deletes included
+    uint64_t ram_epoch = 0;
+
     std::vector<std::string> seg_names;
-    std::vector<Segment> segments;
 
-    std::unordered_map<std::string, MetaInfo> uid_to_meta;
-    fs::path metadata_csv_path;  // Path to metadata.csv for on-demand reads
+    // segments[0, disk_count) are the manifest's; the rest are in-memory
+    // segments of documents added since the last flush (named "ram")
+    size_t disk_count = 0;
+
+    // RAM flushes committed to the manifest this snapshot was read from
+    uint64_t ram_flushes = 0;
 
-    // Autocomplete index built from the loaded lexicon.
-    AutocompleteIndex ac;
+    // Loaded segments are immutable, so reload() hands the unchanged ones
+    // on to the next snapshot instead of opening them again
+    std::vector<SegmentPtr> segments;
+
+    // segments[i]'s live.bin (null while nothing in it is deleted) and the
+    // file's stamp. Deleted docs still count in stats and df until merged.
+    std::vector<std::shared_ptr<const LiveDocs>> live;
+    std::vector<FileStamp> live_stamps;
+
+    // Corpus-wide N and avgdl used for BM25 (term df comes from lookup_term).
+    // RAM docs count in N at once; avgdl is the disk segments' until a flush.
+    CorpusStats stats;
+
+    // metadata.csv row positions and reader, shared until the file changes
+    FileStamp metadata_stamp;
+    std::shared_ptr<const std::unordered_map<std::string, MetaInfo>> uid_to_meta =
+        std::make_shared<const std::unordered_map<std::string, MetaInfo>>();
+    std::shared_ptr<const MetadataStore> metadata = std::make_shared<const MetadataStore>();
+
+    // Autocomplete index over the segments' term dictionaries, shared by
+    // snapshots of the same segments (RAM-only republishes copy none of it)
+    std::shared_ptr<const AutocompleteIndex> ac = std::make_shared<const AutocompleteIndex>();
 
     // Optional semantic expansion index (classic word embeddings).
     // If no embeddings are loaded, search falls back to keyword BM25.
-    SemanticIndex sem;
+    fs::path sem_path;
+    FileStamp sem_stamp;
+    std::shared_ptr<const SemanticIndex> sem = std::make_shared<const SemanticIndex>();
+
+    // Inputs uid_to_meta, ac and sem were derived from (see api_derived.hpp)
+    DerivedKeys derived;
+};
+
+// One ranked document: segment index into the snapshot and docId within it
+struct SearchHit {
+    float s;
+    uint32_t segId;
+    uint32_t docId;
+};
+
+// Deep-pagination candidates for one query on one snapshot generation
+struct ResultSet {
+    uint64_t generation = 0;
+    uint64_t ram_epoch = 0;
+    std::shared_ptr<const IndexSnapshot> snap;  // ranked on; hits index its segments
+    std::vector<SearchHit> hits;  // best first, at most MAX_PAGE_DEPTH
+    uint64_t found = 0;
+};
+
+// Progress and outcome of index reloads (see Engine::reload_status)
+struct ReloadStatus {
+    bool running = false;          // a reload is building a snapshot now
+    bool queued = false;           // another one was requested meanwhile
+    std::string phase = "idle";    // current step: segments, deletes, autocomplete, ...
+    size_t segments_total = 0;     // segments in the manifest being loaded
+    size_t segments_done = 0;      // of those, taken over or opened so far
+    int64_t started_at_ms = 0;     // unix time the last reload started
+    int64_t last_duration_ms = 0;  // wall time of the last finished reload
+    bool last_ok = true;
+    std::string last_error;        // why the last reload failed (old snapshot kept)
+    uint64_t reloads = 0;          // finished reloads, including failed ones
+    uint64_t failures = 0;
+};
+
+struct ResultSetEntry {
+    std::shared_ptr<const ResultSet> set;
+    std::list<std::string>::iterator lru_iter;
+};
+
+struct Engine {
+    fs::path index_dir;
 
     // Search result cache: stores up to 2600 queries with LRU eviction and 24hr expiry
     // Key format: "query|k" (e.g., "covid|10")
@@ -63,11 +164,78 @@ struct Engine {
     size_t ai_summary_cache_updates_since_save = 0;
     static constexpr size_t CACHE_SAVE_INTERVAL = 1; // Save every update for immediate persistence
 
-    std::mutex mtx;
+    // Caches saved by an earlier run are read by the first successful reload only
+    bool caches_loaded = false;
+
+    // Pagination candidate sets: up to 200 queries (LRU), top 1000 hits each.
+    // Key format: "query|mode"; entries from older generations are rebuilt.
+    // A cursor keeps paging its set across RAM adds and deletes.
+    std::unordered_map<std::string, ResultSetEntry> result_sets;
+    std::list<std::string> result_set_lru; // Most recently used at front
+    static constexpr size_t MAX_RESULT_SETS = 200;
+    static constexpr size_t MAX_PAGE_DEPTH = 1000;
+
+    // Workers that score segments of one query in parallel (null = inline)
+    std::unique_ptr<ThreadPool> search_pool;
+
+    // Workers that open segments during reload (null = inline). Separate from
+    // search_pool so a reload does not queue ahead of query scoring.
+    std::unique_ptr<ThreadPool> load_pool;
+
+    // Guards the search, pagination and AI caches (not the index: readers use snapshots)
+    std::mutex cache_mtx;
 
     ~Engine(); // Destructor to save caches on shutdown
+
+    // Build a new snapshot from index_dir and publish it. On any failure the
+    // current snapshot stays in place and false is returned.
     bool reload();
-    json search(const std::string& query, int k);
+
+    // Run reload() on a background thread and return at once. If one is
+    // already running, a single follow-up reload is queued (returns false).
+    bool reload_async();
+
+    // Progress of the running reload and the outcome of the last one
+    ReloadStatus reload_status() const;
+
+    // Delete every indexed copy of `cord_uids`: their bits are cleared in
+    // each segment's live.bin, then the engine reloads. `deleted` counts
+    // the docs newly deleted; merges drop them from the index for good.
+    bool delete_documents(const std::vector<std::string>& cord_uids, size_t& deleted, std::string& err);
+
+    // Add a document to the in-memory buffer: it is searchable when this
+    // returns, and older copies of its cord_uid are deleted (`replaced`).
+    // It reaches disk with the next flush_ram(); until then a crash loses it.
+    bool add_document(RamDoc doc, size_t& replaced, std::string& err);
+
+    // Write the buffered documents out as a new segment, add it to the
+    // manifest and reload. A failed write is retried by the next call.
+    bool flush_ram(std::string& err);
+
+    // Flush whenever ram_policy says so, checking every `interval`
+    void start_ram_flusher(std::chrono::seconds interval);
+    void stop_ram_flusher();
+
+    // Documents buffered in memory (including one being flushed)
+    size_t ram_doc_count();
+
+    // When the RAM buffer is flushed; set before start_ram_flusher()
+    RamFlushPolicy ram_policy;
+
+    // Current index snapshot; safe to call from any thread, never blocks on reload
+    std::shared_ptr<const IndexSnapshot> snapshot() const { return std::atomic_load(&snap_); }
+
+    // Set the search worker pool size; call before serving queries
+    void set_search_threads(size_t n);
+
+    // Set the reload worker pool size; call before reload()
+    void set_load_threads(size_t n);
+    json search(const std::string& query, int k, SearchMode mode = SearchMode::Exhaustive);
+
+    // Page of results starting at `offset`, or at a `cursor` from a previous
+    // page (next_cursor). Returns {"error": ...} for bad or expired cursors.
+    json search_page(const std::string& query, int k, size_t offset,
+                     const std::string& cursor, SearchMode mode = SearchMode::Exhaustive);
     json suggest(const std::string& user_input, int limit);
     
     // Public cache key generator for use by AI overview and other components
@@ -81,6 +249,14 @@ struct Engine {
     json get_ai_summary_from_cache(const std::string& cache_key);
     void put_ai_summary_in_cache(const std::string& cache_key, const json& result);
     
+    // Drop the cached search results (after the index layout changed)
+    void clear_search_cache();
+
+    // Drop the cached results that scored any of `terms` or list any of
+    // `cord_uids` (after a RAM add or a delete)
+    void forget_cached(const std::unordered_set<std::string>& terms,
+                       const std::unordered_set<std::string_view>& cord_uids);
+
     // Cache persistence (save/load to JSON files)
     void save_cache();
     void load_cache();
@@ -90,9 +266,51 @@ struct Engine {
     void load_ai_summary_cache();
     
 private:
-    json get_from_cache(const std::string& cache_key);
+    std::shared_ptr<const IndexSnapshot> snap_ = std::make_shared<IndexSnapshot>();
+    std::mutex reload_mtx;  // serializes reload() calls
+    uint64_t last_generation = 0;  // guarded by ram_mtx
+    uint64_t last_ram_epoch = 0;   // guarded by ram_mtx
+
+    mutable std::mutex status_mtx;  // guards status_ and the async state below
+    ReloadStatus status_;
+    std::thread reload_thread_;
+    bool async_running_ = false;
+
+    std::mutex delete_mtx;  // serializes live.bin read-modify-write
+
+    // Documents added since the last flush, and the buffer being flushed
+    // (searched until a snapshot includes its segment). ram_mtx guards them
+    // and every publish. Lock order: delete_mtx, reload_mtx,
+    // manifest_mutex() (then the index file lock, see ManifestLock), ram_mtx.
+    std::mutex ram_mtx;
+    RamBuffer ram_;
+    std::unique_ptr<RamBuffer> flushing_;
+    uint64_t flushing_epoch_ = 0;  // its manifest commit (0 = not written yet)
+    fs::path flushing_dir_;
+    uint64_t ram_flushes_ = 0;     // flushes committed, guarded by manifest_mutex()
+    std::mutex flush_mtx;          // serializes flush_ram()
+
+    std::thread flusher_;
+    std::mutex flusher_mtx;
+    std::condition_variable flusher_cv;
+    bool flusher_stop_ = false;
+
+    // Keys of the files in derived/, guarded by reload_mtx
+    DerivedKeys derived_saved_;
+
+    bool build_snapshot(std::string& err);
+    void publish(std::shared_ptr<IndexSnapshot> next);
+    void republish();
+    bool delete_on_disk(const std::unordered_set<std::string_view>& wanted, size_t& deleted,
+                        std::string& err, std::optional<ManifestLock>& lock);
+    size_t delete_in_ram(const std::unordered_set<std::string_view>& wanted);
+    void save_derived(const IndexSnapshot& snap);
+    void set_reload_phase(const char* phase, size_t segments_done = 0);
+
+    json get_from_cache(const std::string& cache_key, uint64_t generation);
     bool is_cache_entry_expired(const CacheEntry& entry);
-    void put_in_cache(const std::string& cache_key, const json& result);
+    void put_in_cache(const std::string& cache_key, const json& result, uint64_t generation,
+                      std::vector<std::string> terms);
 };
 
 } // namespace cord19
\ No newline at end of file
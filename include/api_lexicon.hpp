@@ -0,0 +1,56 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "api_mmap.hpp"
+#include "lexicon_mph.hpp"
+
+namespace cord19 {
+
+// One segment's term dictionary.
+//
+// Segments with lexicon.mph are queried in place through its minimal
+// perfect hash: open() only checks the header, and lookups touch a few
+// mapped cache lines. Older segments fill `map` while loading.
+class Lexicon {
+public:
+    // Use the mapped lexicon.mph bytes (must outlive this object)
+    bool open(ByteSpan bytes, std::string& err);
+
+    bool mapped() const { return mapped_; }
+
+    // Entry for `term`, or null if the segment does not contain it
+    const LexEntry* find(std::string_view term) const;
+
+    // Call f(term, entry) for every term with postings
+    template <typename F>
+    void for_each(F&& f) const {
+        if (!mapped_) {
+            for (const auto& kv : map) f(std::string_view(kv.first), kv.second);
+            return;
+        }
+        for (uint32_t tid = 0; tid < h_.entry_count; tid++) {
+            if (entries_[tid].df == 0) continue;
+            std::string_view term;
+            if (term_of(tid, term)) f(term, entries_[tid]);
+        }
+    }
+
+    // Entries of segments without lexicon.mph
+    std::unordered_map<std::string, LexEntry> map;
+
+private:
+    bool mapped_ = false;
+    MphHeader h_{};
+    const uint32_t* pilots_ = nullptr;
+    const uint32_t* slots_ = nullptr;
+    const LexEntry* entries_ = nullptr;
+    const uint32_t* term_offsets_ = nullptr;
+    const char* pool_ = nullptr;
+
+    bool term_of(uint32_t tid, std::string_view& out) const;
+};
+
+} // namespace cord19
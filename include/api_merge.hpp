@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cord19 {
+
+namespace fs = std::filesystem;
+
+// Log-structured merge policy.
+//
+// A segment's tier is floor(log_fanout(doc count)), so one-document segments
+// from adddocument sit in tier 0 and every merge of `fanout` segments lands
+// at least one tier higher. Each document is therefore rewritten at most
+// log_fanout(N) times, and an index keeps O(fanout * log_fanout(N)) segments.
+struct MergePolicy {
+    uint32_t fanout = 10;  // segments merged at once (and tier growth factor)
+};
+
+// Choose the next merge: `count` adjacent segments starting at `first`.
+// Only adjacent runs are merged, so docs keep their corpus order. A run
+// qualifies at tier t when all its segments are in tier t-1 or t; the lowest
+// such tier wins. Returns false when nothing needs merging.
+bool pick_merge(const std::vector<uint32_t>& doc_counts, const MergePolicy& policy,
+                size_t& first, size_t& count);
+
+// Merge segment folders, in order, into a new segment at `outdir`.
+//
+// Postings are copied from the sources' index files with docIds shifted by
+// the docs of the segments before them; nothing is re-tokenized. Docs
+// deleted in a source's live.bin are dropped. Positions and impacts are
+// kept when every source has them. The result is a packed segment like one
+// built by forwardindex + lexicon.
+bool merge_segments(const std::vector<fs::path>& srcs, const fs::path& outdir, std::string& err);
+
+// Run one merge on an index: pick a run (or everything when `all` is set),
+// write the merged segment and swap it into manifest.bin. Tiers use live
+// doc counts, and a run whose docs are all deleted is just removed. The replaced
+// segment names are returned (empty when nothing was merged); their folders
+// are left for remove_segments once no reader maps them.
+bool merge_index_step(const fs::path& index_dir, const MergePolicy& policy, bool all,
+                      std::vector<std::string>& replaced, std::string& err);
+
+// Delete segment folders that are no longer in the manifest
+void remove_segments(const fs::path& index_dir, const std::vector<std::string>& names);
+
+// Periodically applies the merge policy to an index in a background thread.
+//
+// After merging it calls `on_merged` (the server reloads the engine there)
+// before deleting the replaced segments, so new searches never see them.
+class BackgroundMerger {
+public:
+    BackgroundMerger(fs::path index_dir, MergePolicy policy, std::function<bool()> on_merged)
+        : index_dir_(std::move(index_dir)), policy_(policy), on_merged_(std::move(on_merged)) {}
+    ~BackgroundMerger() { stop(); }
+
+    BackgroundMerger(const BackgroundMerger&) = delete;
+    BackgroundMerger& operator=(const BackgroundMerger&) = delete;
+
+    void start(std::chrono::seconds interval);
+    void stop();
+
+private:
+    fs::path index_dir_;
+    MergePolicy policy_;
+    std::function<bool()> on_merged_;
+
+    std::thread thread_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stopping_ = false;
+
+    void run(std::chrono::seconds interval);
+};
+
+} // namespace cord19
@@ -3,21 +3,56 @@
 #include <filesystem>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "api_mmap.hpp"
 #include "api_types.hpp"
 
 namespace cord19 {
 
 // Load metadata.csv byte positions into a map keyed by cord_uid.
+// Rows starting before `from_offset` are skipped: pass the old file size to
+// add just the rows appended since an earlier load.
 void load_metadata_uid_meta(
     const fs::path& metadata_csv,
-    std::unordered_map<std::string, MetaInfo>& uid_to_meta
+    std::unordered_map<std::string, MetaInfo>& uid_to_meta,
+    uint64_t from_offset = 0
 );
 
-// Fetch metadata for a specific cord_uid from file on-demand
-MetaData fetch_metadata(
-    const fs::path& metadata_csv,
-    const MetaInfo& meta_info
-);
+// On-demand reader for metadata.csv rows.
+//
+// The file is mapped and its header parsed once in open(), so hydrating
+// results copies each row straight out of the mapping. Reads take no lock:
+// any number of searches fetch rows at the same time.
+class MetadataStore {
+public:
+    bool open(const fs::path& metadata_csv);
+    bool is_open() const { return open_; }
+
+    // Fetch one row (empty MetaData on failure)
+    MetaData fetch(const MetaInfo& meta_info) const;
+
+    // Fetch many rows; result i belongs to rows[i] (null entries stay empty)
+    std::vector<MetaData> fetch_batch(const std::vector<const MetaInfo*>& rows) const;
+
+private:
+    // Column indices resolved from the header (-1 = column missing)
+    struct Columns {
+        int url = -1;
+        int publish_time = -1;
+        int authors = -1;
+        int title = -1;
+        int abstract = -1;
+    };
+
+    fs::path path_;
+    Columns cols_;
+    bool open_ = false;
+
+    MappedFile file_;
+
+    bool read_row(const MetaInfo& meta_info, std::string& line) const;
+    MetaData parse_row(const std::string& line) const;
+};
 
 } // namespace cord19
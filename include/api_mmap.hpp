@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <utility>
+
+namespace cord19 {
+
+namespace fs = std::filesystem;
+
+// Non-owning view of bytes inside a mapped file
+struct ByteSpan {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    bool empty() const { return size == 0; }
+
+    // Bytes [offset, offset + len), or an empty span if out of range
+    ByteSpan sub(uint64_t offset, uint64_t len) const {
+        if (offset > size || len > size - offset) return ByteSpan{};
+        return ByteSpan{data + offset, (size_t)len};
+    }
+};
+
+// Expected access pattern, passed to the kernel as a readahead hint
+enum class MapAccess {
+    Normal,
+    Random,      // short reads at scattered offsets (postings, positions)
+    Sequential,  // read front to back once (lexicon load)
+    WillNeed     // small and hot: fault it in now (skip lists)
+};
+
+// Read-only mapping of a whole file.
+//
+// The file descriptor is closed right after mapping, so a segment costs no
+// open handles however many barrels it has. Reads are plain memory loads:
+// any number of threads may read one mapping without locking.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map `path` (an empty file maps to an empty span)
+    bool open(const fs::path& path, MapAccess access = MapAccess::Normal);
+    void close();
+
+    bool is_open() const { return open_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+
+    // Bytes [offset, offset + len), or an empty span if out of range
+    ByteSpan span(uint64_t offset, uint64_t len) const {
+        return ByteSpan{data_, size_}.sub(offset, len);
+    }
+
+    void advise(MapAccess access) const;
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    bool open_ = false;
+#ifdef _WIN32
+    void* mapping_ = nullptr;  // file mapping handle (view is data_)
+#endif
+};
+
+// Little-endian field reader over a span (mirrors indexio.hpp's stream
+// helpers). Reading past the end sets ok() to false and returns zeros.
+class ByteReader {
+public:
+    explicit ByteReader(ByteSpan s) : p_(s.data), end_(s.data + s.size) {}
+
+    bool ok() const { return ok_; }
+    size_t remaining() const { return (size_t)(end_ - p_); }
+
+    uint32_t u32() { uint32_t v = 0; take(&v, sizeof(v)); return v; }
+    uint64_t u64() { uint64_t v = 0; take(&v, sizeof(v)); return v; }
+    float f32() { float v = 0.0f; take(&v, sizeof(v)); return v; }
+
+    // Next n bytes in place (empty span and !ok() if fewer remain)
+    ByteSpan bytes(size_t n) {
+        if (!ok_ || n > remaining()) { ok_ = false; return {}; }
+        ByteSpan s{p_, n};
+        p_ += n;
+        return s;
+    }
+
+    // Length-prefixed string
+    std::string str() {
+        uint32_t n = u32();
+        if (!ok_ || n > remaining()) { ok_ = false; return {}; }
+        std::string s((const char*)p_, n);
+        p_ += n;
+        return s;
+    }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+
+    void take(void* out, size_t n) {
+        if (!ok_ || n > remaining()) { ok_ = false; return; }
+        std::memcpy(out, p_, n);
+        p_ += n;
+    }
+};
+
+} // namespace cord19
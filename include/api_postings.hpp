@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "api_mmap.hpp"
+#include "api_types.hpp"
+#include "postings_codec.hpp"
+
+namespace cord19 {
+
+// DocId reported by an exhausted cursor (sorts after every real docId)
+static constexpr uint32_t END_DOC = 0xFFFFFFFFu;
+
+// A term's posting list inside its mapped barrel
+struct PostingSource {
+    ByteSpan postings;                      // encoded postings (empty if out of range)
+    const uint8_t* mapping_end = nullptr;   // end of the barrel mapping
+    uint32_t count = 0;
+    uint32_t codec = POSTINGS_RAW;
+    const SvbSkip* skips = nullptr;         // svb_block_count(count) entries, or null
+};
+
+// Forward cursor over one term's (docId, tf) posting list.
+//
+// Postings are decoded a chunk at a time (raw: CHUNK pairs, compressed: one
+// SVB_BLOCK block) straight from the mapping into fixed buffers inside the
+// cursor, so opening one never allocates; cursors hold no shared state, so
+// any number of them may walk one segment from different threads.
+//
+// With skip entries, advance() binary-searches the term's skip list and jumps
+// straight to the target block; block_for() exposes per-block score bounds.
+class PostingCursor {
+public:
+    explicit PostingCursor(const PostingSource& src);
+
+    uint32_t doc() const { return doc_; }
+    uint32_t tf() const { return tfs_[pos_]; }
+
+    // Move to the next posting (doc() becomes END_DOC at the end)
+    void next();
+
+    // Move to the first posting with docId >= target
+    void advance(uint32_t target);
+
+    // Skip entry of the block holding the first posting >= target, without
+    // moving the cursor. Null when there are no skips or no such block.
+    const SvbSkip* block_for(uint32_t target);
+
+private:
+    static constexpr uint32_t CHUNK = SVB_BLOCK;  // raw postings per refill
+
+    PostingSource src_;
+    uint64_t next_offset_ = 0;           // offset in src_.postings of the next unread posting/block
+    uint32_t remaining_ = 0;             // postings not yet decoded into the buffers
+    std::array<uint32_t, CHUNK> docs_;   // decoded docIds of the current chunk
+    std::array<uint32_t, CHUNK> tfs_;    // decoded tfs of the current chunk
+    uint32_t last_doc_ = 0;              // last docId of the previous block (gap base)
+    uint32_t next_block_ = 0;            // index of the next block to decode
+    uint32_t len_ = 0;                   // postings currently in the buffers
+    uint32_t pos_ = 0;                   // current posting inside the buffers
+    uint32_t doc_ = END_DOC;
+
+    // Padded copy of a block that ends near the mapping end
+    std::array<uint8_t, SVB_MAX_PAYLOAD + SVB_PADDING> block_;
+
+    // Load the next chunk whose last docId is >= target (0 = just the next)
+    bool refill(uint32_t target = 0);
+    bool refill_raw();
+    bool refill_svb(uint32_t target);
+    void seek_block(uint32_t block);
+};
+
+// Locate a term's postings in its mapped barrel (or legacy single file)
+PostingSource posting_source(const Segment& seg, const LexEntry& e);
+
+// Run of a term's postings sharing one quantized impact (impact-ordered index)
+struct ImpactGroup {
+    uint32_t impact = 0;
+    uint32_t count = 0;
+    ByteSpan docs;  // svb(docId gaps), readable for SVB_PADDING bytes past the end
+};
+
+// A term's impact groups, highest impact first. Requires seg.has_impacts;
+// returns false if the list does not fit in its barrel.
+bool read_impact_groups(const Segment& seg, const LexEntry& e, std::vector<ImpactGroup>& out);
+
+// Decode a group's docIds (ascending) into out[0..g.count)
+bool decode_impact_docs(const ImpactGroup& g, std::vector<uint32_t>& out);
+
+// Read n token positions of a term starting at `slot`, where slot is the sum
+// of tf over the term's earlier postings. Requires seg.has_positions.
+// Returns false if the positions lie outside the mapped barrel.
+bool read_positions(const Segment& seg, const LexEntry& e, uint64_t slot,
+                    uint32_t n, std::vector<uint32_t>& out);
+
+} // namespace cord19
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "api_types.hpp"
+
+namespace cord19 {
+
+// A quoted phrase from the query.
+// Terms must occur in order; `slop` is how many extra token positions may sit
+// between the first and last term ("a b"~3). slop 0 = exact phrase.
+struct PhraseClause {
+    std::vector<std::string> terms;
+    uint32_t slop = 0;
+};
+
+// Query split into scoring terms and positional constraints.
+struct ParsedQuery {
+    std::vector<std::string> terms;      // every kept term in query order (phrase terms included)
+    std::vector<PhraseClause> phrases;   // clauses with at least two terms
+};
+
+// Largest accepted proximity window
+static constexpr uint32_t MAX_PHRASE_SLOP = 1000;
+
+// Parse `"quoted phrases"`, optional `~N` proximity windows and plain words.
+// Terms go through the same tokenizer/stopword filter as indexing, so phrase
+// positions line up with the positions stored at index time.
+ParsedQuery parse_query(const std::string& query);
+
+// Sorted docIds of `seg` that satisfy every phrase clause.
+// `ents` holds the lexicon entry of every clause term in this segment,
+// flattened in clause order (resolved by the caller, so no lexicon probes).
+// Segments built without positions fall back to requiring all phrase terms.
+std::vector<uint32_t> match_phrases(const Segment& seg,
+                                    const std::vector<PhraseClause>& phrases,
+                                    const std::vector<const LexEntry*>& ents);
+
+} // namespace cord19
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "api_types.hpp"
+#include "live_docs.hpp"
+#include "segment_writer.hpp"
+
+namespace cord19 {
+
+// A document for near-real-time ingestion: its kept tokens as per-term
+// position lists (tf = list size), as ForwardIndex builds them
+struct RamDoc {
+    DocMeta meta;
+    std::vector<std::pair<std::string, std::vector<uint32_t>>> terms;
+};
+
+// Tokenize `text` like ForwardIndex: tokens of two or more characters,
+// stopwords dropped, positions counted over the kept tokens
+RamDoc make_ram_doc(const std::string& cord_uid, const std::string& title,
+                    const std::string& json_relpath, const std::string& text);
+
+// Build a searchable in-memory segment over docs[first, first + count).
+// Postings use the raw legacy layout (Segment::ram_postings) with positions
+// and score bounds, so every search mode and phrase query runs on it.
+void build_ram_segment(const std::vector<RamDoc>& docs, size_t first, size_t count, Segment& s);
+
+// When a RAM buffer is written out as a disk segment (whichever comes
+// first; 0 disables a trigger)
+struct RamFlushPolicy {
+    size_t max_docs = 1000;
+    uint64_t max_bytes = 64ull << 20;
+    std::chrono::seconds max_age{60};
+};
+
+// Documents added since the last flush, searched before they reach disk.
+//
+// Each add builds a one-document segment, then adjacent runs are merged
+// while the older one is no larger (a binary counter), so a document is
+// rebuilt O(log n) times and n buffered docs are at most log2(n) + 1
+// segments. Deletes only flag docs; the flushed segment gets a live.bin.
+class RamBuffer {
+public:
+    // Buffered docs [first, first + count) as one searchable segment
+    struct Run {
+        size_t first = 0;
+        size_t count = 0;
+        SegmentPtr seg;
+    };
+
+    void add(RamDoc doc);
+
+    // Delete the buffered copies of `cord_uid`; returns how many were live
+    size_t remove(std::string_view cord_uid);
+
+    bool empty() const { return docs_.empty(); }
+    size_t doc_count() const { return docs_.size(); }
+    uint64_t bytes() const { return bytes_; }  // buffered terms and positions (approximate)
+    bool flush_due(const RamFlushPolicy& policy) const;
+
+    const std::vector<Run>& runs() const { return runs_; }
+
+    // Deletion bitmap of a run, or of every buffered doc (null while none is deleted)
+    std::shared_ptr<const LiveDocs> run_live(const Run& run) const;
+    std::shared_ptr<const LiveDocs> live_docs() const;
+
+    // Add every buffered doc (deleted ones too, so docIds match live_docs())
+    void fill_writer(SegmentWriter& w) const;
+
+private:
+    std::vector<RamDoc> docs_;
+    std::vector<char> deleted_;
+    std::unordered_map<std::string, std::vector<size_t>> by_uid_;  // cord_uid -> indexes in docs_
+    size_t deleted_count_ = 0;
+    std::vector<Run> runs_;
+    uint64_t bytes_ = 0;
+    std::chrono::steady_clock::time_point first_added_;
+
+    std::shared_ptr<const LiveDocs> live_range(size_t first, size_t count) const;
+};
+
+} // namespace cord19
@@ -1,19 +1,71 @@
 #pragma once
 
 #include <filesystem>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "api_types.hpp"
+#include "index_lock.hpp"
+#include "thread_pool.hpp"
 
 namespace cord19 {
 
 std::vector<std::string> load_manifest(const fs::path& manifest_path);
-void save_manifest(const fs::path& manifest_path, const std::vector<std::string>& segs);
+bool save_manifest(const fs::path& manifest_path, const std::vector<std::string>& segs);
+
+// Segment names of an index in manifest order (falls back to the seg_* folders)
+std::vector<std::string> list_segments(const fs::path& index_dir);
 
 std::string seg_name(uint32_t id);
 
-bool load_segment(const fs::path& segdir, Segment& s);
+// First seg_NNNNNN name after every segment in the manifest or on disk
+std::string next_segment_name(const fs::path& index_dir);
+
+// Held by in-process writers of manifest.bin (merges, RAM flushes) while they
+// claim a segment name (creating its folder) and while they read, modify and
+// save the manifest, so neither loses the other's update. Deletes hold it
+// while writing live.bin, so a merge never swaps out a segment mid-delete.
+std::mutex& manifest_mutex();
+
+// manifest_mutex() plus the index's file lock, which keeps out writers in
+// other processes (adddocument, mergesegments). ok() is false when the lock
+// file cannot be taken; callers then give up instead of writing unguarded.
+class ManifestLock {
+public:
+    explicit ManifestLock(const fs::path& index_dir) : mtx_(manifest_mutex()), file_(index_dir) {}
+    bool ok() const { return file_.locked(); }
+
+private:
+    std::lock_guard<std::mutex> mtx_;
+    IndexFileLock file_;
+};
+
+// Open a segment folder. With a pool, lexicon barrels are processed by its
+// workers (load_segment may itself run on one of them). Bulk sections are
+// not checksummed yet: callers run s.store.verify_bulk() before using them.
+bool load_segment(const fs::path& segdir, Segment& s, ThreadPool* pool = nullptr);
+
+// Size and mtime of a file (exists=false when it is missing)
+FileStamp file_stamp(const fs::path& path);
+
+// Stamp of a segment's files: segment.seg, or all loose files of older segments
+FileStamp segment_stamp(const fs::path& segdir);
+
+// Sort the segment's docIds by cord_uid into s.uid_order
+void build_uid_order(Segment& s);
+
+// docIds of `cord_uid` in the segment, as a range of s.uid_order
+std::pair<const uint32_t*, const uint32_t*> find_uid(const Segment& s, std::string_view cord_uid);
+
+// Fold one loaded segment's doc count and lengths into the corpus-wide stats
+void add_segment_stats(CorpusStats& stats, const Segment& s);
+
+// Look `term` up in every segment: corpus df and the segments holding it.
+// Returns false if no segment contains it.
+bool lookup_term(const std::vector<SegmentPtr>& segments, std::string_view term, TermStats& out);
 
 // For /add_document (single-doc segment creation)
 void write_barrelized_index_files_single_doc(
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "api_mmap.hpp"
+#include "segment_file.hpp"
+#include "thread_pool.hpp"
+
+namespace cord19 {
+
+// Read-only access to a segment's files by name.
+//
+// A v2 segment is one mapped segment.seg whose sections are served in place.
+// open() verifies the header, the section table and the checksums of the
+// small sections the loader reads; verify_bulk() checksums the postings,
+// positions and forward sections, which reload runs before a segment is
+// published. Older segments keep loose files, which are mapped one by one on
+// first access.
+class SegmentStore {
+public:
+    bool open(const fs::path& segdir, std::string& err);
+
+    // True when the segment is a single segment.seg container
+    bool packed() const { return packed_; }
+
+    // Checksum the sections open() skipped (in parallel with a pool);
+    // true for loose files, which carry no checksums
+    bool verify_bulk(std::string& err, ThreadPool* pool = nullptr) const;
+
+    bool has(const std::string& name) const;
+
+    // Bytes of file `name`; false if the segment has no such file
+    bool get(const std::string& name, ByteSpan& out, MapAccess access = MapAccess::Normal);
+
+    // Unmap a loose file whose contents were copied out (no-op when packed)
+    void release(const std::string& name) { loose_.erase(name); }
+
+private:
+    fs::path dir_;
+    bool packed_ = false;
+    MappedFile container_;
+    std::unordered_map<std::string, ByteSpan> sections_;  // packed: name -> bytes
+    std::vector<SegmentSection> bulk_;                    // packed: not checksummed by open()
+    std::unordered_map<std::string, MappedFile> loose_;   // loose: files mapped so far
+};
+
+} // namespace cord19
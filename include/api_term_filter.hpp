@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "api_mmap.hpp"
+#include "lexicon_bloom.hpp"
+
+namespace cord19 {
+
+// One segment's term filter (lexicon.bloom), read in place.
+//
+// may_contain() never misses a term of the segment; a filter that was never
+// opened passes everything. Older segments without lexicon.bloom get one
+// encoded from their lexicon instead (adopt()).
+class TermFilter {
+public:
+    // Use the mapped lexicon.bloom bytes (must outlive this object)
+    bool open(ByteSpan bytes, std::string& err);
+
+    // Take ownership of an encoded image (see encode_term_filter)
+    bool adopt(std::vector<uint8_t> bytes, std::string& err);
+
+    // False only if the term with bloom_term_hash() `h` is not in the segment
+    bool may_contain(uint64_t h) const {
+        if (!blocks_) return true;
+        uint64_t mask = bloom_block_mask(h, hash_count_);
+        return (blocks_[bloom_block_index(h, block_count_)] & mask) == mask;
+    }
+
+private:
+    std::vector<uint8_t> owned_;  // adopted image (empty when mapped)
+    const uint64_t* blocks_ = nullptr;
+    uint64_t block_count_ = 0;
+    uint32_t hash_count_ = 0;
+};
+
+} // namespace cord19
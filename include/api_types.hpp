@@ -1,13 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
-#include <fstream>
-#include <mutex>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
+#include "api_dictionary.hpp"
+#include "api_lexicon.hpp"
+#include "api_mmap.hpp"
+#include "api_segment_file.hpp"
+#include "api_term_filter.hpp"
 #include "barrels.hpp"
+#include "bm25.hpp"
 #include "third_party/nlohmann/json.hpp"
 
 namespace cord19 {
@@ -15,19 +22,6 @@ namespace cord19 {
 namespace fs = std::filesystem;
 using json = nlohmann::json;
 
-struct DocInfo {
-    std::string cord_uid;  // Kept for matching with metadata index
-    uint32_t doc_len = 0;  // Needed for BM25 scoring
-};
-
-struct LexEntry {
-    uint32_t termId = 0;
-    uint32_t df = 0;
-    uint64_t offset = 0;
-    uint32_t count = 0;
-    uint32_t barrelId = 0; // used only when barrels enabled
-};
-
 // Store byte positions in metadata.csv file for on-demand loading
 struct MetaInfo {
     uint64_t file_offset = 0;  // Byte position where this row starts in metadata.csv
@@ -43,20 +37,108 @@ struct MetaData {
     std::string abstract;
 };
 
+// Size and modification time of a file (or a folder's files), used to tell
+// whether something on disk changed since it was loaded
+struct FileStamp {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool exists = false;
+
+    bool operator==(const FileStamp& o) const {
+        return size == o.size && mtime == o.mtime && exists == o.exists;
+    }
+    bool operator!=(const FileStamp& o) const { return !(*this == o); }
+};
+
 struct Segment {
     fs::path dir;
+    FileStamp stamp;  // segment files as of load_segment (see segment_stamp)
     uint32_t N = 0;
     float avgdl = 0.0f;
-    std::vector<DocInfo> docs;
-    std::unordered_map<std::string, LexEntry> lex;
+    uint64_t total_len = 0;  // sum of doc_lens
+
+    // Per-doc columns indexed by docId. Scoring scales doc_lens by the
+    // corpus avgdl; the packed cord_uids are read just for the final top-K hits.
+    std::vector<uint32_t> doc_lens;
+    std::string uid_pool;               // all cord_uids back to back
+    std::vector<uint32_t> uid_offsets;  // docId -> start in uid_pool (N+1 entries)
+    std::vector<uint32_t> uid_order;    // docIds sorted by cord_uid (see find_uid)
+
+    uint32_t doc_count() const { return (uint32_t)doc_lens.size(); }
+
+    std::string_view cord_uid(uint32_t docId) const {
+        return std::string_view(uid_pool).substr(
+            uid_offsets[docId], uid_offsets[docId + 1] - uid_offsets[docId]);
+    }
+
+    // Term -> LexEntry (mapped lexicon.mph, or in memory for older segments)
+    Lexicon lex;
+
+    // The same terms in sorted order, for prefix scans (mapped lexicon.dict,
+    // or encoded from `lex` for older segments)
+    TermDictionary dict;
+
+    // Filter checked before `lex` when a query term is looked up across
+    // segments (mapped lexicon.bloom, or built from `lex` for older segments)
+    TermFilter filter;
+
+    // True when bounds.bin filled LexEntry::max_tf/min_dl (enables pruning)
+    bool has_bounds = false;
+
+    // Index files are memory-mapped read-only (one segment.seg, or loose
+    // files for older segments), so query threads read postings straight
+    // from the mappings without locks or copies. The spans below point
+    // into `store`.
+    SegmentStore store;
 
     // legacy
-    std::ifstream inv;
+    ByteSpan inv;
+
+    // In-memory segments (api_ram_segment.hpp) own their raw postings and
+    // positions; `inv` and pos_barrels[0] point into these
+    std::vector<uint32_t> ram_postings;
+    std::vector<uint32_t> ram_positions;
 
     // barrels
     bool use_barrels = false;
     BarrelParams barrel_params{};
-    std::vector<std::ifstream> inv_barrels;
+    std::vector<ByteSpan> inv_barrels;
+
+    // Optional per-block skip entries (compressed barrels only)
+    bool has_skips = false;
+    std::vector<ByteSpan> skip_barrels;
+
+    // Optional positions barrels (phrase/proximity matching); barrels only
+    bool has_positions = false;
+    std::vector<ByteSpan> pos_barrels;
+
+    // Optional impact-ordered postings (mode=impact); barrels only
+    bool has_impacts = false;
+    std::vector<ByteSpan> impact_barrels;
+};
+
+// Loaded segments never change, so index snapshots share them
+using SegmentPtr = std::shared_ptr<const Segment>;
+
+// A query term's lexicon entry in one loaded segment
+struct TermSegEntry {
+    uint32_t segId = 0;
+    const LexEntry* e = nullptr;
+};
+
+// Corpus-wide statistics for one query term (see lookup_term)
+struct TermStats {
+    uint32_t df = 0;                 // summed over all segments
+    std::vector<TermSegEntry> segs;  // segments that contain the term
+};
+
+// Corpus-wide BM25 statistics over every loaded segment.
+// Scoring uses these instead of each segment's own N/avgdl so scores are
+// comparable across segments; term df is summed per query by lookup_term.
+struct CorpusStats {
+    uint64_t N = 0;
+    uint64_t total_len = 0;
+    float avgdl = 0.0f;
 };
 
 } // namespace cord19
@@ -0,0 +1,422 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "indexio.hpp"
+#include "barrels.hpp"
+#include "bm25.hpp"
+#include "lexicon_bloom.hpp"
+#include "lexicon_dict.hpp"
+#include "lexicon_mph.hpp"
+
+namespace fs = std::filesystem;
+
+// Posting entry for inverted index
+struct Posting { uint32_t docId; uint32_t tf; };
+
+// Path for per-term score bound inputs (indexed by termId)
+inline fs::path term_bounds_path(const fs::path& segdir) {
+    return segdir / "bounds.bin";
+}
+
+// Encoded size of one term's postings (docId order) under `codec`
+inline uint64_t encoded_postings_bytes(const std::vector<Posting>& plist, uint32_t codec) {
+    if (codec != POSTINGS_SVB) return (uint64_t)plist.size() * sizeof(uint32_t) * 2;
+    uint64_t bytes = 0;
+    uint32_t prev = 0;
+    for (size_t i = 0; i < plist.size(); i += SVB_BLOCK) {
+        uint32_t n = (uint32_t)std::min<size_t>(SVB_BLOCK, plist.size() - i);
+        bytes += SVB_BLOCK_HEADER + 2 * ((n + 3) / 4);
+        for (uint32_t j = 0; j < n; j++) {
+            const Posting& p = plist[i + j];
+            bytes += svb_value_len(p.docId - prev) + svb_value_len(p.tf);
+            prev = p.docId;
+        }
+    }
+    return bytes;
+}
+
+// First termId of each barrel, cutting the termId order where the running
+// postings size crosses each 1/barrel_count share of the total. TermIds
+// follow first-seen order, so equal termId ranges would put nearly all
+// frequent terms (and bytes) in barrel 0. A term bigger than a share fills
+// its barrel alone and the barrels it skips over stay empty.
+inline std::vector<uint32_t> balanced_barrel_starts(const std::vector<uint64_t>& term_bytes,
+                                                    uint32_t barrel_count) {
+    uint32_t tcount = (uint32_t)term_bytes.size();
+    uint64_t total = 0;
+    for (uint64_t n : term_bytes) total += n;
+
+    std::vector<uint32_t> first(barrel_count, tcount);
+    uint32_t next = 0;
+    uint64_t before = 0;
+    for (uint32_t tid = 0; tid < tcount; tid++) {
+        // Barrel of the term's midpoint, so a term straddling a cut goes to
+        // the side holding most of it
+        uint64_t mid = before + term_bytes[tid] / 2;
+        uint32_t b = total ? (uint32_t)std::min<uint64_t>(barrel_count - 1, mid * barrel_count / total) : 0;
+        while (next <= b && next < barrel_count) first[next++] = tid;
+        before += term_bytes[tid];
+    }
+    return first;
+}
+
+// Write barrelized inverted + lexicon files and per-term bounds for a segment.
+// Shared by the lexicon tool, SegmentWriter and the API ingestion paths so the
+// on-disk layout only has to change in one place.
+//
+// Per-barrel lexicon entry format:
+//   term(string), termId(u32), df(u32), offset(u64), count(u32)
+//   [+ bytes(u32): encoded postings length, when the codec is not raw]
+//
+// Terms are split into barrels by encoded postings size (see
+// balanced_barrel_starts); the boundaries are recorded in barrels.bin.
+//
+// Postings are written with `codec` (see postings_codec.hpp); the choice is
+// recorded in barrels.bin so readers pick the matching decoder. Compressed
+// barrels also get skips_bNNN.bin with one SvbSkip per block, giving readers
+// block-level seeking and per-block score bounds.
+//
+// bounds.bin format:
+//   tcount(u32); for each termId: max_tf(u32), min_dl(u32)
+// BM25 grows with tf and shrinks with doc length, so (max_tf, min_dl) yields a
+// valid per-term score upper bound for any k1, b and avgdl.
+//
+// Optional `positions[termId]` holds the term's token positions for each of
+// its postings in docId order (tf entries per posting, ascending). When given,
+// postings must already be in docId order, and the writer also emits:
+//   positions_bNNN.bin: per term, the concatenated position lists (u32 each)
+//   positions.bin:      tcount(u32); for each termId: offset(u64) into its barrel
+//
+// Every entry, with its skip and position offsets and bounds resolved, is
+// also written to lexicon.mph (see lexicon_mph.hpp), which readers query in
+// place, and the terms with their df to the sorted lexicon.dict (see
+// lexicon_dict.hpp) for prefix scans. The per-barrel lexicons stay for older
+// readers.
+inline bool write_barrelized_index(
+    const fs::path& segdir,
+    const std::vector<std::string>& terms,
+    std::vector<std::vector<Posting>>& inverted,
+    const std::vector<uint32_t>& doc_lens,
+    std::string& err,
+    const std::vector<std::vector<uint32_t>>* positions = nullptr,
+    uint32_t codec = POSTINGS_SVB
+) {
+    if (codec != POSTINGS_RAW && codec != POSTINGS_SVB) { err = "unknown postings codec"; return false; }
+
+    uint32_t tcount = (uint32_t)terms.size();
+    if (inverted.size() < tcount) { err = "postings do not cover every term"; return false; }
+    if (positions && positions->size() < tcount) { err = "positions do not cover every term"; return false; }
+
+    // Put postings in docId order and size them, to place barrel boundaries
+    std::vector<uint64_t> term_bytes(tcount, 0);
+    auto by_doc = [](const Posting& a, const Posting& b) { return a.docId < b.docId; };
+    for (uint32_t tid = 0; tid < tcount; tid++) {
+        auto& plist = inverted[tid];
+
+        // Position lists follow posting order, so they cannot be reordered here
+        if (positions) {
+            if (!std::is_sorted(plist.begin(), plist.end(), by_doc)) {
+                err = "postings with positions must be in docId order";
+                return false;
+            }
+        } else {
+            std::sort(plist.begin(), plist.end(), by_doc);
+        }
+        term_bytes[tid] = encoded_postings_bytes(plist, codec);
+    }
+
+    BarrelParams bp;
+    bp.barrel_count = BARREL_COUNT;
+    bp.codec = codec;
+    bp.terms_per_barrel = 0;
+    bp.first_term = balanced_barrel_starts(term_bytes, bp.barrel_count);
+
+    write_barrels_manifest(segdir, bp);
+
+    std::vector<std::ofstream> inv(bp.barrel_count);
+    std::vector<std::ofstream> lex(bp.barrel_count);
+    std::vector<std::ofstream> skips(codec == POSTINGS_SVB ? bp.barrel_count : 0);
+    std::vector<uint64_t> offsets(bp.barrel_count, 0);
+    std::vector<uint64_t> skip_offsets(bp.barrel_count, 0);
+    std::vector<uint32_t> barrel_term_counts(bp.barrel_count, 0);
+    std::vector<LexEntry> entries(tcount);
+
+    // Scratch for encoding one term's postings
+    std::vector<uint8_t> encoded;
+    std::vector<uint32_t> block_docs, block_tfs;
+
+    // Open barrel output files
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        inv[b].open(inv_barrel_path(segdir, b), std::ios::binary);
+        lex[b].open(lex_barrel_path(segdir, b), std::ios::binary);
+        if (!inv[b] || !lex[b]) { err = "failed to open barrel files for writing"; return false; }
+        write_u32(lex[b], 0); // placeholder
+
+        if (!skips.empty()) {
+            skips[b].open(skip_barrel_path(segdir, b), std::ios::binary);
+            if (!skips[b]) { err = "failed to open skip barrel for writing"; return false; }
+        }
+    }
+
+    std::ofstream bounds(term_bounds_path(segdir), std::ios::binary);
+    if (!bounds) { err = "failed to open bounds.bin for writing"; return false; }
+    write_u32(bounds, tcount);
+
+    // Open positions outputs only when the caller has positions
+    std::vector<std::ofstream> pos(positions ? bp.barrel_count : 0);
+    std::vector<uint64_t> pos_offsets(pos.size(), 0);
+    std::ofstream pos_index;
+    if (positions) {
+        for (uint32_t b = 0; b < bp.barrel_count; b++) {
+            pos[b].open(pos_barrel_path(segdir, b), std::ios::binary);
+            if (!pos[b]) { err = "failed to open positions barrel for writing"; return false; }
+        }
+        pos_index.open(pos_index_path(segdir), std::ios::binary);
+        if (!pos_index) { err = "failed to open positions.bin for writing"; return false; }
+        write_u32(pos_index, tcount);
+    }
+
+    // Write postings and lex entries per term
+    for (uint32_t tid = 0; tid < tcount; tid++) {
+        auto& plist = inverted[tid];
+
+        uint32_t max_tf = 0;
+        uint32_t min_dl = 0;
+        uint64_t pos_offset = 0;
+
+        if (!plist.empty()) {
+            uint32_t df = (uint32_t)plist.size();
+            uint32_t b  = barrel_for_term(tid, bp);
+
+            barrel_term_counts[b]++;
+
+            min_dl = UINT32_MAX;
+            for (auto& p : plist) {
+                max_tf = std::max(max_tf, p.tf);
+                uint32_t dl = p.docId < doc_lens.size() ? doc_lens[p.docId] : 0;
+                min_dl = std::min(min_dl, dl);
+            }
+
+            // Encode the whole list first so the lexicon can record its size
+            uint64_t bytes = 0;
+            if (codec == POSTINGS_SVB) {
+                encoded.clear();
+                uint32_t prev_last = 0;
+                for (uint32_t i = 0; i < df; i += SVB_BLOCK) {
+                    uint32_t n = std::min(SVB_BLOCK, df - i);
+                    block_docs.resize(n);
+                    block_tfs.resize(n);
+
+                    SvbSkip sk{0, (uint32_t)encoded.size(), 0, UINT32_MAX};
+                    for (uint32_t j = 0; j < n; j++) {
+                        const Posting& p = plist[i + j];
+                        block_docs[j] = p.docId;
+                        block_tfs[j] = p.tf;
+                        sk.max_tf = std::max(sk.max_tf, p.tf);
+                        sk.min_dl = std::min(sk.min_dl, p.docId < doc_lens.size() ? doc_lens[p.docId] : 0u);
+                    }
+                    svb_encode_block(block_docs.data(), block_tfs.data(), n, prev_last, encoded);
+                    prev_last = block_docs[n - 1];
+
+                    sk.last_doc = prev_last;
+                    skips[b].write((const char*)&sk, sizeof(sk));
+                }
+                inv[b].write((const char*)encoded.data(), (std::streamsize)encoded.size());
+                bytes = encoded.size();
+            } else {
+                for (auto& p : plist) {
+                    write_u32(inv[b], p.docId);
+                    write_u32(inv[b], p.tf);
+                }
+                bytes = (uint64_t)df * (sizeof(uint32_t) * 2);
+            }
+
+            write_string(lex[b], terms[tid]);
+            write_u32(lex[b], tid);
+            write_u32(lex[b], df);
+            write_u64(lex[b], offsets[b]);
+            write_u32(lex[b], df);
+            if (codec != POSTINGS_RAW) write_u32(lex[b], (uint32_t)bytes);
+
+            if (positions) {
+                const auto& tpos = (*positions)[tid];
+                pos_offset = pos_offsets[b];
+                for (uint32_t p : tpos) write_u32(pos[b], p);
+                pos_offsets[b] += (uint64_t)tpos.size() * sizeof(uint32_t);
+            }
+
+            LexEntry& e = entries[tid];
+            e.termId = tid;
+            e.df = df;
+            e.offset = offsets[b];
+            e.count = df;
+            e.barrelId = b;
+            e.bytes = (codec != POSTINGS_RAW) ? (uint32_t)bytes : 0;
+            e.skip_offset = skip_offsets[b];
+            e.max_tf = max_tf;
+            e.min_dl = min_dl;
+            e.pos_offset = pos_offset;
+
+            offsets[b] += bytes;
+            if (codec == POSTINGS_SVB) skip_offsets[b] += (uint64_t)svb_block_count(df) * sizeof(SvbSkip);
+        }
+
+        write_u32(bounds, max_tf);
+        write_u32(bounds, min_dl);
+        if (positions) write_u64(pos_index, pos_offset);
+    }
+
+    // A full disk only shows up as a failed stream; catch it before the
+    // segment is packed
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        inv[b].close();
+        if (!inv[b]) { err = "failed to write " + inv_barrel_path(segdir, b).string(); return false; }
+        if (codec == POSTINGS_SVB) {
+            skips[b].close();
+            if (!skips[b]) { err = "failed to write " + skip_barrel_path(segdir, b).string(); return false; }
+        }
+        if (positions) {
+            pos[b].close();
+            if (!pos[b]) { err = "failed to write " + pos_barrel_path(segdir, b).string(); return false; }
+        }
+    }
+    bounds.close();
+    if (!bounds) { err = "failed to write bounds.bin"; return false; }
+    if (positions) {
+        pos_index.close();
+        if (!pos_index) { err = "failed to write positions.bin"; return false; }
+    }
+
+    // Patch header counts in each lex barrel file
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        lex[b].close();
+        if (!lex[b]) { err = "failed to write " + lex_barrel_path(segdir, b).string(); return false; }
+
+        std::ofstream patch(lex_barrel_path(segdir, b),
+                            std::ios::in | std::ios::out | std::ios::binary);
+        if (!patch) { err = "failed to patch lexicon barrel"; return false; }
+        patch.seekp(0, std::ios::beg);
+        write_u32(patch, barrel_term_counts[b]);
+        patch.close();
+        if (!patch) { err = "failed to patch lexicon barrel"; return false; }
+    }
+
+    return write_mph_lexicon(segdir, terms, entries, err) &&
+           write_term_dictionary(segdir, terms, entries, err) &&
+           write_term_filter(segdir, terms, entries, err);
+}
+
+// Write the optional impact-ordered copy of a segment's postings, using the
+// barrel layout already written by write_barrelized_index.
+//
+// Each posting's tf is replaced by its quantized BM25 tf component
+// (quantize_impact, computed against the segment's avgdl), and a term's
+// postings are grouped by impact, highest first, so queries can score
+// high-impact postings first and stop early.
+//
+// impacts_bNNN.bin, per term:
+//   ngroups(u32); per group: impact(u32), count(u32), bytes(u32),
+//                            svb(docId gaps, ascending within the group)
+//   followed at the end of each barrel by SVB_PADDING zero bytes
+// impacts.bin:
+//   tcount(u32), k1(f32), b(f32), avgdl(f32);
+//   for each termId: offset(u64) into its barrel (also patched into the
+//   entries of lexicon.mph when the segment has one)
+inline bool write_impact_index(
+    const fs::path& segdir,
+    const std::vector<std::vector<Posting>>& inverted,
+    const std::vector<uint32_t>& doc_lens,
+    std::string& err
+) {
+    BarrelParams bp;
+    if (!read_barrels_manifest(segdir, bp)) { err = "missing barrels.bin"; return false; }
+
+    uint64_t total_len = 0;
+    for (uint32_t dl : doc_lens) total_len += dl;
+    float avgdl = doc_lens.empty() ? 1.0f : (float)total_len / (float)doc_lens.size();
+    if (avgdl <= 0.0f) avgdl = 1.0f;
+
+    std::vector<std::ofstream> out(bp.barrel_count);
+    std::vector<uint64_t> offsets(bp.barrel_count, 0);
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        out[b].open(impact_barrel_path(segdir, b), std::ios::binary);
+        if (!out[b]) { err = "failed to open impact barrel for writing"; return false; }
+    }
+
+    std::ofstream index(impact_index_path(segdir), std::ios::binary);
+    if (!index) { err = "failed to open impacts.bin for writing"; return false; }
+    uint32_t tcount = (uint32_t)inverted.size();
+    write_u32(index, tcount);
+    write_f32(index, BM25_K1);
+    write_f32(index, BM25_B);
+    write_f32(index, avgdl);
+
+    // Scratch: (impact, docId) pairs of one term and one group's gaps
+    std::vector<uint64_t> term_offsets(tcount, 0);
+    std::vector<std::pair<uint32_t, uint32_t>> by_impact;
+    std::vector<uint32_t> gaps;
+    std::vector<uint8_t> encoded;
+
+    for (uint32_t tid = 0; tid < tcount; tid++) {
+        const auto& plist = inverted[tid];
+        uint32_t b = barrel_for_term(tid, bp);
+        write_u64(index, plist.empty() ? 0 : offsets[b]);
+        if (plist.empty()) continue;
+        term_offsets[tid] = offsets[b];
+
+        by_impact.clear();
+        for (const auto& p : plist) {
+            uint32_t dl = p.docId < doc_lens.size() ? doc_lens[p.docId] : 0;
+            by_impact.push_back({quantize_impact(p.tf, dl, avgdl), p.docId});
+        }
+        std::sort(by_impact.begin(), by_impact.end(),
+                  [](const auto& x, const auto& y) {
+                      return x.first != y.first ? x.first > y.first : x.second < y.second;
+                  });
+
+        uint32_t ngroups = 0;
+        for (size_t i = 0; i < by_impact.size(); i++) {
+            if (i == 0 || by_impact[i].first != by_impact[i - 1].first) ngroups++;
+        }
+        write_u32(out[b], ngroups);
+        offsets[b] += sizeof(uint32_t);
+
+        for (size_t i = 0; i < by_impact.size();) {
+            size_t j = i;
+            gaps.clear();
+            uint32_t prev = 0;
+            for (; j < by_impact.size() && by_impact[j].first == by_impact[i].first; j++) {
+                gaps.push_back(by_impact[j].second - prev);
+                prev = by_impact[j].second;
+            }
+
+            encoded.clear();
+            svb_encode(gaps.data(), (uint32_t)gaps.size(), encoded);
+            write_u32(out[b], by_impact[i].first);
+            write_u32(out[b], (uint32_t)gaps.size());
+            write_u32(out[b], (uint32_t)encoded.size());
+            out[b].write((const char*)encoded.data(), (std::streamsize)encoded.size());
+            offsets[b] += sizeof(uint32_t) * 3 + encoded.size();
+            i = j;
+        }
+    }
+
+    // Tail padding lets readers decode the last group in place
+    const char pad[SVB_PADDING] = {};
+    for (auto& o : out) {
+        o.write(pad, SVB_PADDING);
+        o.close();
+        if (!o) { err = "failed to write impact barrel"; return false; }
+    }
+    index.close();
+    if (!index) { err = "failed to write impacts.bin"; return false; }
+
+    // Hashed lexicons carry the offsets in their entries
+    if (fs::exists(mph_lexicon_path(segdir))) return patch_mph_impact_offsets(segdir, term_offsets, err);
+    return true;
+}
@@ -1,20 +1,29 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <fstream>
 #include "indexio.hpp"
+#include "postings_codec.hpp"
 
 namespace fs = std::filesystem;
 
 // Barrel count setting
 static constexpr uint32_t BARREL_COUNT = 64;
 
-// Barrel config stored per segment
+// Barrel config stored per segment.
+// Older segments split termIds into equal ranges of terms_per_barrel; newer
+// ones record the first termId of each barrel in first_term, with ranges
+// chosen so barrels hold similar postings bytes (terms_per_barrel is then 0).
 struct BarrelParams {
     uint32_t barrel_count = BARREL_COUNT;
     uint32_t terms_per_barrel = 0;
+    uint32_t codec = POSTINGS_RAW;  // postings encoding in inverted barrels
+    std::vector<uint32_t> first_term;  // balanced layout, one per barrel (ascending)
 };
 
 // Path for barrels manifest file
@@ -22,24 +31,55 @@ inline fs::path barrels_manifest_path(const fs::path& segdir) {
     return segdir / "barrels.bin";
 }
 
-// Write barrel config to disk
+// barrels.bin format:
+//   barrel_count(u32), terms_per_barrel(u32), [codec(u32)],
+//   [first_term(u32) * barrel_count]
+// Codec is omitted for raw equal-range barrels (the original layout); a
+// balanced layout always writes it so the boundaries can follow.
 inline void write_barrels_manifest(const fs::path& segdir, const BarrelParams& p) {
     std::ofstream out(barrels_manifest_path(segdir), std::ios::binary);
     write_u32(out, p.barrel_count);
     write_u32(out, p.terms_per_barrel);
+    if (p.codec != POSTINGS_RAW || !p.first_term.empty()) write_u32(out, p.codec);
+    for (uint32_t t : p.first_term) write_u32(out, t);
+}
+
+// Parse barrels.bin bytes (older manifests have no codec field: raw, and no
+// boundaries: equal termId ranges)
+inline bool parse_barrels_manifest(const uint8_t* data, size_t size, BarrelParams& p) {
+    size_t at = 0;
+    auto next = [&](uint32_t& v) {
+        if (size - at < sizeof(uint32_t)) return false;
+        std::memcpy(&v, data + at, sizeof(uint32_t));
+        at += sizeof(uint32_t);
+        return true;
+    };
+    if (!next(p.barrel_count) || !next(p.terms_per_barrel)) return false;
+    if (!next(p.codec)) p.codec = POSTINGS_RAW;
+    p.first_term.clear();
+    if (size - at >= (uint64_t)p.barrel_count * sizeof(uint32_t)) {
+        p.first_term.resize(p.barrel_count);
+        for (auto& t : p.first_term) next(t);
+        if (!std::is_sorted(p.first_term.begin(), p.first_term.end())) return false;
+    }
+    return true;
 }
 
 // Read barrel config from disk
 inline bool read_barrels_manifest(const fs::path& segdir, BarrelParams& p) {
     std::ifstream in(barrels_manifest_path(segdir), std::ios::binary);
     if (!in) return false;
-    p.barrel_count = read_u32(in);
-    p.terms_per_barrel = read_u32(in);
-    return true;
+    std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return parse_barrels_manifest((const uint8_t*)bytes.data(), bytes.size(), p);
 }
 
 // Map termId to barrel id
 inline uint32_t barrel_for_term(uint32_t termId, const BarrelParams& p) {
+    if (!p.first_term.empty()) {
+        // Last barrel starting at or before termId (skips empty barrels)
+        auto it = std::upper_bound(p.first_term.begin(), p.first_term.end(), termId);
+        return it == p.first_term.begin() ? 0 : (uint32_t)(it - p.first_term.begin()) - 1;
+    }
     if (p.terms_per_barrel == 0) return 0;
     uint32_t b = termId / p.terms_per_barrel;
     if (b >= p.barrel_count) b = p.barrel_count - 1;
@@ -63,6 +103,31 @@ inline fs::path lex_barrel_path(const fs::path& segdir, uint32_t barrel_id) {
     return segdir / ("lexicon_b" + barrel_suffix(barrel_id) + ".bin");
 }
 
+// Path for one skip barrel file (compressed postings only)
+inline fs::path skip_barrel_path(const fs::path& segdir, uint32_t barrel_id) {
+    return segdir / ("skips_b" + barrel_suffix(barrel_id) + ".bin");
+}
+
+// Path for one positions barrel file (optional, parallel to inverted barrels)
+inline fs::path pos_barrel_path(const fs::path& segdir, uint32_t barrel_id) {
+    return segdir / ("positions_b" + barrel_suffix(barrel_id) + ".bin");
+}
+
+// Path for per-term offsets into the positions barrels
+inline fs::path pos_index_path(const fs::path& segdir) {
+    return segdir / "positions.bin";
+}
+
+// Path for one impact-ordered postings barrel (optional)
+inline fs::path impact_barrel_path(const fs::path& segdir, uint32_t barrel_id) {
+    return segdir / ("impacts_b" + barrel_suffix(barrel_id) + ".bin");
+}
+
+// Path for per-term offsets into the impact barrels
+inline fs::path impact_index_path(const fs::path& segdir) {
+    return segdir / "impacts.bin";
+}
+
 // Quick check if barrel files exist
 inline bool has_barrels(const fs::path& segdir) {
     return fs::exists(barrels_manifest_path(segdir)) &&
@@ -0,0 +1,41 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// BM25 parameters, shared by the query engine and index-time impact building
+static constexpr float BM25_K1 = 1.2f;
+static constexpr float BM25_B = 0.75f;
+
+// BM25 length normalization k1*(1-b+b*dl/avgdl) for one document
+inline float bm25_norm(float dl, float avgdl) {
+    return BM25_K1 * (1.0f - BM25_B + BM25_B * (dl / avgdl));
+}
+
+// The same normalization against one avgdl, as base + slope * dl, so query
+// time scales raw doc lengths instead of keeping a per-doc table
+struct BM25LengthNorm {
+    float base = 0.0f;
+    float slope = 0.0f;
+
+    explicit BM25LengthNorm(float avgdl)
+        : base(BM25_K1 * (1.0f - BM25_B)), slope(BM25_K1 * BM25_B / avgdl) {}
+
+    float operator()(uint32_t dl) const { return base + slope * (float)dl; }
+};
+
+// Quantized impacts (impact-ordered index, see write_impact_index).
+// A posting's BM25 tf component tf*(k1+1)/(tf+norm) lies in (0, k1+1); it is
+// stored as an integer level 1..IMPACT_LEVELS, so one level is worth
+// impact_step() before the query-time idf weight is applied.
+static constexpr uint32_t IMPACT_LEVELS = 255;
+
+inline float impact_step() {
+    return (BM25_K1 + 1.0f) / (float)IMPACT_LEVELS;
+}
+
+inline uint32_t quantize_impact(uint32_t tf, uint32_t dl, float avgdl) {
+    float w = (float)tf * (BM25_K1 + 1.0f) / ((float)tf + bm25_norm((float)dl, avgdl));
+    long q = std::lround(w / impact_step());
+    return (uint32_t)std::min<long>(std::max<long>(q, 1), IMPACT_LEVELS);
+}
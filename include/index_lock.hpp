@@ -0,0 +1,83 @@
+#pragma once
+#include <cerrno>
+#include <filesystem>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// Exclusive advisory lock on an index (index_dir/manifest.lock).
+//
+// Every process that rewrites manifest.bin or a live.bin holds it for the
+// whole read-modify-write: the server's merges, RAM flushes and deletes, and
+// the adddocument and mergesegments tools. Inside the server it is taken
+// together with manifest_mutex() (see ManifestLock), since the lock belongs
+// to an open file and not to a thread. The lock file is never removed.
+
+inline fs::path index_lock_path(const fs::path& index_dir) {
+    return index_dir / "manifest.lock";
+}
+
+class IndexFileLock {
+public:
+    // Blocks until the lock is held; locked() is false if it cannot be taken
+    explicit IndexFileLock(const fs::path& index_dir) {
+        fs::path path = index_lock_path(index_dir);
+#ifdef _WIN32
+        h_ = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h_ == INVALID_HANDLE_VALUE) return;
+        OVERLAPPED ov{};
+        if (!LockFileEx(h_, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &ov)) {
+            CloseHandle(h_);
+            h_ = INVALID_HANDLE_VALUE;
+        }
+#else
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd_ < 0) return;
+        int rc;
+        while ((rc = ::flock(fd_, LOCK_EX)) != 0 && errno == EINTR) {}
+        if (rc != 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    ~IndexFileLock() {
+#ifdef _WIN32
+        if (h_ != INVALID_HANDLE_VALUE) CloseHandle(h_);  // releases the lock
+#else
+        if (fd_ >= 0) ::close(fd_);  // releases the lock
+#endif
+    }
+
+    IndexFileLock(const IndexFileLock&) = delete;
+    IndexFileLock& operator=(const IndexFileLock&) = delete;
+
+    bool locked() const {
+#ifdef _WIN32
+        return h_ != INVALID_HANDLE_VALUE;
+#else
+        return fd_ >= 0;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE h_ = INVALID_HANDLE_VALUE;
+#else
+    int fd_ = -1;
+#endif
+};
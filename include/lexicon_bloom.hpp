@@ -0,0 +1,97 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexicon_mph.hpp"
+
+namespace fs = std::filesystem;
+
+// Blocked Bloom filter over a segment's terms (lexicon.bloom).
+//
+// A query term is hashed once and tested against every segment's filter
+// before its lexicon is probed, so a term missing from most segments costs
+// one word read per segment instead of a hash table lookup and a term
+// compare. Each term sets BLOOM_HASH_COUNT bits in one 64-bit block:
+//   header (BloomHeader)
+//   blocks: u64[block_count]
+// The block is picked by the high 32 bits of bloom_term_hash(), the bits by
+// 6-bit fields of the low ones.
+
+static constexpr char BLOOM_MAGIC[8] = {'N', 'X', 'L', 'E', 'X', 'B', 'L', 'M'};
+static constexpr uint32_t BLOOM_VERSION = 1;
+static constexpr uint32_t BLOOM_HASH_COUNT = 4;
+static constexpr uint32_t BLOOM_BITS_PER_TERM = 16;  // about 0.5% false positives
+static constexpr uint64_t BLOOM_SEED = 0x6c65786963626c6dULL;
+
+struct BloomHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t hash_count;
+    uint64_t block_count;
+};
+static_assert(sizeof(BloomHeader) == 24, "BloomHeader is written as raw bytes");
+
+// Path of the term filter inside a segment directory
+inline fs::path bloom_lexicon_path(const fs::path& segdir) {
+    return segdir / "lexicon.bloom";
+}
+
+inline uint64_t bloom_term_hash(std::string_view term) {
+    return mph_hash(term.data(), term.size(), BLOOM_SEED);
+}
+
+inline uint64_t bloom_block_index(uint64_t h, uint64_t block_count) {
+    return ((h >> 32) * block_count) >> 32;
+}
+
+inline uint64_t bloom_block_mask(uint64_t h, uint32_t hash_count) {
+    uint64_t mask = 0;
+    for (uint32_t i = 0; i < hash_count; i++) mask |= 1ULL << ((h >> (6 * i)) & 63);
+    return mask;
+}
+
+// Encode a whole lexicon.bloom image for terms with the given hashes
+inline void encode_term_filter(const std::vector<uint64_t>& hashes, std::vector<uint8_t>& out) {
+    uint64_t block_count = ((uint64_t)hashes.size() * BLOOM_BITS_PER_TERM + 63) / 64;
+    if (block_count == 0) block_count = 1;
+    if (block_count > UINT32_MAX) block_count = UINT32_MAX;
+
+    std::vector<uint64_t> blocks(block_count, 0);
+    for (uint64_t h : hashes) blocks[bloom_block_index(h, block_count)] |= bloom_block_mask(h, BLOOM_HASH_COUNT);
+
+    BloomHeader h{};
+    std::memcpy(h.magic, BLOOM_MAGIC, sizeof(BLOOM_MAGIC));
+    h.version = BLOOM_VERSION;
+    h.hash_count = BLOOM_HASH_COUNT;
+    h.block_count = block_count;
+
+    out.resize(sizeof(h) + blocks.size() * sizeof(uint64_t));
+    std::memcpy(out.data(), &h, sizeof(h));
+    std::memcpy(out.data() + sizeof(h), blocks.data(), blocks.size() * sizeof(uint64_t));
+}
+
+// Write lexicon.bloom for one segment: every term with postings (df > 0).
+// entries are indexed by termId like lexicon.mph's.
+inline bool write_term_filter(const fs::path& segdir, const std::vector<std::string>& terms,
+                              const std::vector<LexEntry>& entries, std::string& err) {
+    if (terms.size() < entries.size()) { err = "filter terms do not cover every entry"; return false; }
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(entries.size());
+    for (uint32_t tid = 0; tid < (uint32_t)entries.size(); tid++)
+        if (entries[tid].df > 0) hashes.push_back(bloom_term_hash(terms[tid]));
+
+    std::vector<uint8_t> bytes;
+    encode_term_filter(hashes, bytes);
+
+    std::ofstream out(bloom_lexicon_path(segdir), std::ios::binary);
+    if (!out) { err = "failed to open lexicon.bloom for writing"; return false; }
+    out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+    if (!out) { err = "failed to write lexicon.bloom"; return false; }
+    return true;
+}
@@ -0,0 +1,147 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexicon_mph.hpp"
+
+namespace fs = std::filesystem;
+
+// Sorted, front-coded term dictionary (lexicon.dict).
+//
+// Terms with postings are stored in byte order, DICT_BLOCK_SIZE per block.
+// The first term of a block is stored whole; every later term keeps only the
+// suffix after the prefix it shares with the term before it. The block
+// offsets form a sparse index: a prefix search binary-searches the block
+// first terms in place and decodes one block, and iteration continues
+// through the following blocks. Layout:
+//   header (DictHeader)
+//   block_offsets: u32[block_count + 1] into the data area
+//   data:          per term: varint shared, varint suffix_len, suffix bytes,
+//                  varint termId, varint df
+// Lookups by exact term stay with lexicon.mph; this file adds order.
+
+static constexpr char DICT_MAGIC[8] = {'N', 'X', 'L', 'E', 'X', 'D', 'I', 'C'};
+static constexpr uint32_t DICT_VERSION = 1;
+static constexpr uint32_t DICT_BLOCK_SIZE = 16;
+
+struct DictHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t term_count;
+    uint32_t block_count;
+    uint64_t data_size;
+};
+static_assert(sizeof(DictHeader) == 32, "DictHeader is written as raw bytes");
+
+// Path of the sorted dictionary inside a segment directory
+inline fs::path dict_lexicon_path(const fs::path& segdir) {
+    return segdir / "lexicon.dict";
+}
+
+inline void dict_put_varint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+// Decode a varint at p (advanced past it); false if it runs past end
+inline bool dict_get_varint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        if (p >= end) return false;
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+// A dictionary record before encoding
+struct DictTerm {
+    std::string_view term;
+    uint32_t termId = 0;
+    uint32_t df = 0;
+};
+
+// Encode a whole lexicon.dict image. `sorted` must be in strictly increasing
+// term order.
+inline bool encode_term_dictionary(const std::vector<DictTerm>& sorted, std::vector<uint8_t>& out,
+                                   std::string& err) {
+    uint32_t n = (uint32_t)sorted.size();
+    uint32_t block_count = (n + DICT_BLOCK_SIZE - 1) / DICT_BLOCK_SIZE;
+
+    std::vector<uint32_t> block_offsets;
+    block_offsets.reserve(block_count + 1);
+    std::vector<uint8_t> data;
+    std::string_view prev;
+    for (uint32_t i = 0; i < n; i++) {
+        const DictTerm& t = sorted[i];
+        if (i > 0 && !(prev < t.term)) { err = "dictionary terms are not sorted and unique"; return false; }
+
+        size_t shared = 0;
+        if (i % DICT_BLOCK_SIZE == 0) {
+            if (data.size() > UINT32_MAX) { err = "dictionary too large"; return false; }
+            block_offsets.push_back((uint32_t)data.size());
+        } else {
+            size_t m = std::min(prev.size(), t.term.size());
+            while (shared < m && prev[shared] == t.term[shared]) shared++;
+        }
+        dict_put_varint(data, (uint32_t)shared);
+        dict_put_varint(data, (uint32_t)(t.term.size() - shared));
+        data.insert(data.end(), t.term.begin() + shared, t.term.end());
+        dict_put_varint(data, t.termId);
+        dict_put_varint(data, t.df);
+        prev = t.term;
+    }
+    if (data.size() > UINT32_MAX) { err = "dictionary too large"; return false; }
+    block_offsets.push_back((uint32_t)data.size());
+
+    DictHeader h{};
+    std::memcpy(h.magic, DICT_MAGIC, sizeof(DICT_MAGIC));
+    h.version = DICT_VERSION;
+    h.block_size = DICT_BLOCK_SIZE;
+    h.term_count = n;
+    h.block_count = block_count;
+    h.data_size = data.size();
+
+    out.resize(sizeof(h) + block_offsets.size() * sizeof(uint32_t) + data.size());
+    uint8_t* p = out.data();
+    std::memcpy(p, &h, sizeof(h));
+    p += sizeof(h);
+    std::memcpy(p, block_offsets.data(), block_offsets.size() * sizeof(uint32_t));
+    p += block_offsets.size() * sizeof(uint32_t);
+    if (!data.empty()) std::memcpy(p, data.data(), data.size());
+    return true;
+}
+
+// Write lexicon.dict for one segment: every term with postings (df > 0),
+// sorted. entries are indexed by termId like lexicon.mph's.
+inline bool write_term_dictionary(const fs::path& segdir, const std::vector<std::string>& terms,
+                                  const std::vector<LexEntry>& entries, std::string& err) {
+    if (terms.size() < entries.size()) { err = "dictionary terms do not cover every entry"; return false; }
+
+    std::vector<DictTerm> sorted;
+    for (uint32_t tid = 0; tid < (uint32_t)entries.size(); tid++)
+        if (entries[tid].df > 0) sorted.push_back(DictTerm{terms[tid], tid, entries[tid].df});
+    std::sort(sorted.begin(), sorted.end(),
+              [](const DictTerm& a, const DictTerm& b) { return a.term < b.term; });
+
+    std::vector<uint8_t> bytes;
+    if (!encode_term_dictionary(sorted, bytes, err)) return false;
+
+    std::ofstream out(dict_lexicon_path(segdir), std::ios::binary);
+    if (!out) { err = "failed to open lexicon.dict for writing"; return false; }
+    out.write((const char*)bytes.data(), (std::streamsize)bytes.size());
+    if (!out) { err = "failed to write lexicon.dict"; return false; }
+    return true;
+}
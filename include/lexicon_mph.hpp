@@ -0,0 +1,252 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// A term's lexicon entry in one segment. Also the on-disk record of
+// lexicon.mph, which readers use in place, so the layout is fixed.
+struct LexEntry {
+    uint32_t termId = 0;
+    uint32_t df = 0;
+    uint64_t offset = 0;
+    uint32_t count = 0;
+    uint32_t barrelId = 0; // used only when barrels enabled
+    uint32_t bytes = 0;    // encoded postings size (compressed barrels only)
+    uint32_t reserved = 0;
+    uint64_t skip_offset = 0; // first SvbSkip of this term in its skip barrel
+
+    // Score bound inputs from bounds.bin (0 when the segment has none)
+    uint32_t max_tf = 0;   // largest tf in this term's postings
+    uint32_t min_dl = 0;   // shortest doc length among those postings
+
+    // Start of this term's position lists in its positions barrel
+    uint64_t pos_offset = 0;
+
+    // Start of this term's impact groups in its impact barrel
+    uint64_t impact_offset = 0;
+};
+static_assert(sizeof(LexEntry) == 64, "LexEntry is written as raw bytes");
+
+// Minimal-perfect-hash lexicon (lexicon.mph).
+//
+// Terms hash into buckets of about MPH_BUCKET_LOAD keys; each bucket stores
+// a pilot that sends its keys to distinct slots of a table with exactly one
+// slot per term (CHD/PTHash style). A lookup is one hash, one pilot read,
+// one slot read and one string compare, straight from the mapped file, so
+// loading a segment no longer builds a hash map of its terms. Layout:
+//   header (MphHeader)
+//   pilots:       u32[bucket_count]
+//   slots:        u32[key_count], termId stored in each slot
+//   entries:      LexEntry[entry_count], indexed by termId (64-byte aligned)
+//   term_offsets: u32[entry_count + 1] into the pool
+//   pool:         term bytes back to back
+// Terms without postings keep a zeroed entry and are not in the table.
+
+static constexpr char MPH_MAGIC[8] = {'N', 'X', 'L', 'E', 'X', 'M', 'P', 'H'};
+static constexpr uint32_t MPH_VERSION = 1;
+static constexpr uint32_t MPH_BUCKET_LOAD = 4;
+
+struct MphHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t key_count;
+    uint32_t entry_count;
+    uint32_t bucket_count;
+    uint64_t seed;
+    uint64_t pilots_offset;
+    uint64_t slots_offset;
+    uint64_t entries_offset;
+    uint64_t term_offsets_offset;
+    uint64_t pool_offset;
+    uint64_t pool_size;
+};
+static_assert(sizeof(MphHeader) == 80, "MphHeader is written as raw bytes");
+
+// Path of the hashed lexicon inside a segment directory
+inline fs::path mph_lexicon_path(const fs::path& segdir) {
+    return segdir / "lexicon.mph";
+}
+
+inline uint64_t mph_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// Seeded 64-bit term hash (FNV-1a, then mixed); fixed so files are portable
+inline uint64_t mph_hash(const char* s, size_t n, uint64_t seed) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ seed;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)s[i];
+        h *= 0x100000001b3ULL;
+    }
+    return mph_mix(h);
+}
+
+inline uint32_t mph_bucket(uint64_t h, uint32_t bucket_count) {
+    return (uint32_t)(((h >> 32) * (uint64_t)bucket_count) >> 32);
+}
+
+inline uint32_t mph_slot(uint64_t h, uint32_t pilot, uint32_t key_count) {
+    return (uint32_t)(mph_mix(h ^ mph_mix((uint64_t)pilot + 1)) % key_count);
+}
+
+// Find a pilot per bucket so every key gets its own slot. Buckets are placed
+// largest first, while most slots are still free. Fails (try another seed)
+// if two keys share a hash or a bucket runs out of pilots.
+inline bool build_mph(const std::vector<uint64_t>& hashes, uint32_t bucket_count,
+                      std::vector<uint32_t>& pilots, std::vector<uint32_t>& slot_of_key) {
+    uint32_t n = (uint32_t)hashes.size();
+    pilots.assign(bucket_count, 0);
+    slot_of_key.assign(n, 0);
+    if (n == 0) return true;
+
+    // Group keys by bucket (counting sort)
+    std::vector<uint32_t> start(bucket_count + 1, 0);
+    for (uint64_t h : hashes) start[mph_bucket(h, bucket_count) + 1]++;
+    for (uint32_t b = 0; b < bucket_count; b++) start[b + 1] += start[b];
+    std::vector<uint32_t> keys(n);
+    {
+        std::vector<uint32_t> at(start.begin(), start.end() - 1);
+        for (uint32_t k = 0; k < n; k++) keys[at[mph_bucket(hashes[k], bucket_count)]++] = k;
+    }
+
+    std::vector<uint32_t> order(bucket_count);
+    for (uint32_t b = 0; b < bucket_count; b++) order[b] = b;
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return start[a + 1] - start[a] > start[b + 1] - start[b];
+    });
+
+    std::vector<bool> taken(n, false);
+    std::vector<uint32_t> slots;
+    const uint64_t max_pilot = std::max<uint64_t>(1u << 20, (uint64_t)n * 64);
+    for (uint32_t b : order) {
+        uint32_t first = start[b], size = start[b + 1] - start[b];
+        if (size == 0) break;
+
+        for (uint32_t i = first; i < first + size; i++)
+            for (uint32_t j = first; j < i; j++)
+                if (hashes[keys[i]] == hashes[keys[j]]) return false;
+
+        bool placed = false;
+        for (uint64_t p = 0; p < max_pilot && !placed; p++) {
+            slots.clear();
+            placed = true;
+            for (uint32_t i = first; i < first + size && placed; i++) {
+                uint32_t s = mph_slot(hashes[keys[i]], (uint32_t)p, n);
+                if (taken[s] || std::find(slots.begin(), slots.end(), s) != slots.end()) placed = false;
+                else slots.push_back(s);
+            }
+            if (!placed) continue;
+            pilots[b] = (uint32_t)p;
+            for (uint32_t i = 0; i < size; i++) {
+                taken[slots[i]] = true;
+                slot_of_key[keys[first + i]] = slots[i];
+            }
+        }
+        if (!placed) return false;
+    }
+    return true;
+}
+
+// Write lexicon.mph for one segment. entries[termId] must be complete except
+// impact_offset, which write_impact_index patches in later.
+inline bool write_mph_lexicon(const fs::path& segdir, const std::vector<std::string>& terms,
+                              const std::vector<LexEntry>& entries, std::string& err) {
+    uint32_t tcount = (uint32_t)entries.size();
+    if (terms.size() < tcount) { err = "lexicon terms do not cover every entry"; return false; }
+
+    std::vector<uint32_t> key_terms;
+    for (uint32_t tid = 0; tid < tcount; tid++)
+        if (entries[tid].df > 0) key_terms.push_back(tid);
+    uint32_t n = (uint32_t)key_terms.size();
+    uint32_t bucket_count = std::max<uint32_t>(1, (n + MPH_BUCKET_LOAD - 1) / MPH_BUCKET_LOAD);
+
+    // A fresh seed re-hashes everything; duplicate terms fail every seed
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint32_t> pilots, slot_of_key;
+    uint64_t seed = 0;
+    bool built = false;
+    for (uint32_t attempt = 0; attempt < 8 && !built; attempt++) {
+        seed = mph_mix(0x6c6578696d706800ULL + attempt);
+        for (uint32_t k = 0; k < n; k++) {
+            const std::string& t = terms[key_terms[k]];
+            hashes[k] = mph_hash(t.data(), t.size(), seed);
+        }
+        built = build_mph(hashes, bucket_count, pilots, slot_of_key);
+    }
+    if (!built) { err = "failed to build lexicon hash (duplicate terms?)"; return false; }
+
+    std::vector<uint32_t> slots(n, 0);
+    for (uint32_t k = 0; k < n; k++) slots[slot_of_key[k]] = key_terms[k];
+
+    std::vector<uint32_t> term_offsets(tcount + 1, 0);
+    uint64_t pool_size = 0;
+    for (uint32_t tid = 0; tid < tcount; tid++) {
+        term_offsets[tid] = (uint32_t)pool_size;
+        if (entries[tid].df > 0) pool_size += terms[tid].size();
+        if (pool_size > UINT32_MAX) { err = "lexicon term pool too large"; return false; }
+    }
+    term_offsets[tcount] = (uint32_t)pool_size;
+
+    MphHeader h{};
+    std::memcpy(h.magic, MPH_MAGIC, sizeof(MPH_MAGIC));
+    h.version = MPH_VERSION;
+    h.key_count = n;
+    h.entry_count = tcount;
+    h.bucket_count = bucket_count;
+    h.seed = seed;
+    h.pilots_offset = sizeof(MphHeader);
+    h.slots_offset = h.pilots_offset + (uint64_t)bucket_count * sizeof(uint32_t);
+    h.entries_offset = (h.slots_offset + (uint64_t)n * sizeof(uint32_t) + 63) / 64 * 64;
+    h.term_offsets_offset = h.entries_offset + (uint64_t)tcount * sizeof(LexEntry);
+    h.pool_offset = h.term_offsets_offset + (uint64_t)(tcount + 1) * sizeof(uint32_t);
+    h.pool_size = pool_size;
+
+    std::ofstream out(mph_lexicon_path(segdir), std::ios::binary);
+    if (!out) { err = "failed to open lexicon.mph for writing"; return false; }
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)pilots.data(), (std::streamsize)(pilots.size() * sizeof(uint32_t)));
+    out.write((const char*)slots.data(), (std::streamsize)(slots.size() * sizeof(uint32_t)));
+    static const char zeros[64] = {};
+    out.write(zeros, (std::streamsize)(h.entries_offset - h.slots_offset - (uint64_t)n * sizeof(uint32_t)));
+    out.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(LexEntry)));
+    out.write((const char*)term_offsets.data(), (std::streamsize)(term_offsets.size() * sizeof(uint32_t)));
+    for (uint32_t tid = 0; tid < tcount; tid++)
+        if (entries[tid].df > 0) out.write(terms[tid].data(), (std::streamsize)terms[tid].size());
+    if (!out) { err = "failed to write lexicon.mph"; return false; }
+    return true;
+}
+
+// Record each term's impact_offset in an existing lexicon.mph
+inline bool patch_mph_impact_offsets(const fs::path& segdir, const std::vector<uint64_t>& offsets,
+                                     std::string& err) {
+    std::fstream f(mph_lexicon_path(segdir), std::ios::in | std::ios::out | std::ios::binary);
+    if (!f) { err = "failed to open lexicon.mph"; return false; }
+
+    MphHeader h;
+    if (!f.read((char*)&h, sizeof(h)) || std::memcmp(h.magic, MPH_MAGIC, sizeof(MPH_MAGIC)) != 0 ||
+        h.entry_count != offsets.size()) {
+        err = "lexicon.mph does not match the impact index";
+        return false;
+    }
+
+    std::vector<LexEntry> entries(h.entry_count);
+    f.seekg((std::streamoff)h.entries_offset, std::ios::beg);
+    f.read((char*)entries.data(), (std::streamsize)(entries.size() * sizeof(LexEntry)));
+    for (size_t i = 0; i < entries.size(); i++) entries[i].impact_offset = offsets[i];
+    f.seekp((std::streamoff)h.entries_offset, std::ios::beg);
+    f.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(LexEntry)));
+    if (!f) { err = "failed to patch lexicon.mph"; return false; }
+    return true;
+}
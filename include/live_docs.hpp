@@ -0,0 +1,153 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "segment_file.hpp"
+
+namespace fs = std::filesystem;
+
+// Per-segment live-doc bitmap (live.bin).
+//
+// Segment files never change once written, so deleting a document only
+// clears its bit in live.bin, which sits beside segment.seg (it is not a
+// section of it). A segment without live.bin has every doc live. Layout:
+//   header (16 bytes, LiveHeader)
+//   u64 words[(doc_count + 63) / 64], bit d set = doc d is live
+// The file is replaced by rename, so readers see the old or the new bitmap.
+// Merges drop deleted docs for good.
+
+static constexpr char LIVE_MAGIC[8] = {'N', 'X', 'L', 'I', 'V', 'E', '0', '1'};
+
+struct LiveHeader {
+    char magic[8];
+    uint32_t doc_count;
+    uint32_t deleted_count;
+};
+static_assert(sizeof(LiveHeader) == 16, "LiveHeader is written as raw bytes");
+
+inline fs::path live_docs_path(const fs::path& segdir) {
+    return segdir / "live.bin";
+}
+
+struct LiveDocs {
+    uint32_t doc_count = 0;
+    uint32_t deleted = 0;
+    std::vector<uint64_t> words;
+
+    // Every doc live
+    void reset(uint32_t n) {
+        doc_count = n;
+        deleted = 0;
+        words.assign(((size_t)n + 63) / 64, ~0ull);
+        if (n % 64) words.back() = (1ull << (n % 64)) - 1;
+    }
+
+    bool is_live(uint32_t d) const { return (words[d >> 6] >> (d & 63)) & 1; }
+
+    // Clear doc d; false if it was already deleted
+    bool remove(uint32_t d) {
+        if (!is_live(d)) return false;
+        words[d >> 6] &= ~(1ull << (d & 63));
+        deleted++;
+        return true;
+    }
+};
+
+// Load segdir's live.bin for a segment of doc_count docs (all live if absent)
+inline bool read_live_docs(const fs::path& segdir, uint32_t doc_count, LiveDocs& out, std::string& err) {
+    out.reset(doc_count);
+    fs::path path = live_docs_path(segdir);
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return true;
+
+    std::ifstream in(path, std::ios::binary);
+    LiveHeader h;
+    if (!in || !in.read((char*)&h, sizeof(h))) { err = "cannot read " + path.string(); return false; }
+    if (std::memcmp(h.magic, LIVE_MAGIC, sizeof(LIVE_MAGIC)) != 0) { err = path.string() + ": bad magic"; return false; }
+    if (h.doc_count != doc_count) { err = path.string() + ": doc count does not match the segment"; return false; }
+    if (!in.read((char*)out.words.data(), (std::streamsize)(out.words.size() * sizeof(uint64_t)))) {
+        err = path.string() + ": truncated";
+        return false;
+    }
+
+    // Recount rather than trust the header (bits past doc_count are ignored)
+    if (doc_count % 64) out.words.back() &= (1ull << (doc_count % 64)) - 1;
+    uint32_t live = 0;
+    for (uint64_t w : out.words) live += (uint32_t)__builtin_popcountll(w);
+    out.deleted = doc_count - live;
+    return true;
+}
+
+// deleted_count from the header of segdir's live.bin (0 when absent,
+// UINT32_MAX when unreadable). Each rewrite deletes more docs, so this tells
+// two rewrites apart even when they land within one mtime tick.
+inline uint32_t read_live_deleted_count(const fs::path& segdir) {
+    fs::path path = live_docs_path(segdir);
+    std::error_code ec;
+    if (!fs::exists(path, ec)) return 0;
+
+    std::ifstream in(path, std::ios::binary);
+    LiveHeader h;
+    if (!in || !in.read((char*)&h, sizeof(h))) return UINT32_MAX;
+    return h.deleted_count;
+}
+
+inline bool write_live_docs(const fs::path& segdir, const LiveDocs& live, std::string& err) {
+    fs::path path = live_docs_path(segdir);
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        LiveHeader h{};
+        std::memcpy(h.magic, LIVE_MAGIC, sizeof(LIVE_MAGIC));
+        h.doc_count = live.doc_count;
+        h.deleted_count = live.deleted;
+        out.write((const char*)&h, sizeof(h));
+        out.write((const char*)live.words.data(), (std::streamsize)(live.words.size() * sizeof(uint64_t)));
+        if (!out) { err = "failed to write " + tmp.string(); return false; }
+    }
+    std::error_code ec;
+    fs::rename(tmp, path, ec);
+    if (ec) { err = "failed to replace " + path.string(); return false; }
+    return true;
+}
+
+// cord_uids of a segment's docs in docId order (from docs.bin)
+inline bool read_doc_uids(const fs::path& segdir, std::vector<std::string>& uids, std::string& err) {
+    uids.clear();
+    std::vector<char> bytes;
+    if (!read_segment_bytes(segdir, "docs.bin", bytes, err)) return false;
+
+    size_t at = 0;
+    auto u32 = [&](uint32_t& v) {
+        if (bytes.size() - at < sizeof(v)) return false;
+        std::memcpy(&v, bytes.data() + at, sizeof(v));
+        at += sizeof(v);
+        return true;
+    };
+    auto str = [&](std::string* s) {
+        uint32_t len = 0;
+        if (!u32(len) || bytes.size() - at < len) return false;
+        if (s) s->assign(bytes.data() + at, len);
+        at += len;
+        return true;
+    };
+
+    uint32_t n = 0;
+    if (!u32(n)) { err = "docs.bin too short"; return false; }
+    uids.resize(n);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t doc_len = 0;
+        if (!str(&uids[i]) || !str(nullptr) || !str(nullptr) || !u32(doc_len)) {
+            err = "docs.bin truncated";
+            return false;
+        }
+    }
+    return true;
+}
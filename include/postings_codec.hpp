@@ -0,0 +1,224 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define POSTINGS_CODEC_SSSE3 1
+#include <immintrin.h>
+#endif
+
+// Postings codec ids (stored in barrels.bin)
+static constexpr uint32_t POSTINGS_RAW = 0;  // (docId u32, tf u32) pairs
+static constexpr uint32_t POSTINGS_SVB = 1;  // StreamVByte blocks, see below
+
+// Postings per StreamVByte block
+static constexpr uint32_t SVB_BLOCK = 128;
+
+// Readers must leave this many readable bytes after a block payload
+// (the SIMD kernel loads 16 bytes at a time)
+static constexpr uint32_t SVB_PADDING = 16;
+
+// Block layout (POSTINGS_SVB), one per SVB_BLOCK postings, last may be short:
+//   last_doc(u32)      largest docId in the block (lets readers skip blocks)
+//   payload_len(u32)   bytes that follow
+//   payload:           svb(docId gaps) then svb(tf)
+// DocId gaps are relative to the previous block's last_doc (0 for the first).
+// svb(values) = ceil(n/4) control bytes (2 bits per value: byte length - 1)
+//               followed by the little-endian value bytes.
+static constexpr uint32_t SVB_BLOCK_HEADER = 8;
+
+// Largest payload of a full block: control and 4-byte values for docs and tfs
+static constexpr uint32_t SVB_MAX_PAYLOAD = 2 * ((SVB_BLOCK + 3) / 4 + SVB_BLOCK * 4);
+
+// Skip entry for one block, stored in skips_bNNN.bin next to the barrel.
+// A term's entries are contiguous and terms appear in the same order as in
+// the inverted barrel, so each term's skip list starts after the previous
+// term's ceil(count / SVB_BLOCK) entries.
+struct SvbSkip {
+    uint32_t last_doc;  // largest docId in the block
+    uint32_t offset;    // block start, relative to the term's postings offset
+    uint32_t max_tf;    // largest tf in the block
+    uint32_t min_dl;    // shortest doc length in the block
+};
+static_assert(sizeof(SvbSkip) == 16, "SvbSkip is written as raw bytes");
+
+// Number of blocks (and skip entries) for a list of n postings
+inline uint32_t svb_block_count(uint32_t n) {
+    return (n + SVB_BLOCK - 1) / SVB_BLOCK;
+}
+
+// Bytes used to store one value
+inline uint32_t svb_value_len(uint32_t v) {
+    if (v < (1u << 8)) return 1;
+    if (v < (1u << 16)) return 2;
+    if (v < (1u << 24)) return 3;
+    return 4;
+}
+
+// Append n values as StreamVByte (control bytes, then data bytes)
+inline void svb_encode(const uint32_t* in, uint32_t n, std::vector<uint8_t>& out) {
+    size_t ctrl_at = out.size();
+    out.resize(ctrl_at + (n + 3) / 4, 0);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t len = svb_value_len(in[i]);
+        out[ctrl_at + i / 4] |= (uint8_t)((len - 1) << ((i % 4) * 2));
+        for (uint32_t b = 0; b < len; b++) out.push_back((uint8_t)(in[i] >> (8 * b)));
+    }
+}
+
+// Encode one block of postings into `out` (header + payload)
+inline void svb_encode_block(const uint32_t* docs, const uint32_t* tfs, uint32_t n,
+                             uint32_t prev_last_doc, std::vector<uint8_t>& out) {
+    uint32_t gaps[SVB_BLOCK];
+    uint32_t prev = prev_last_doc;
+    for (uint32_t i = 0; i < n; i++) {
+        gaps[i] = docs[i] - prev;
+        prev = docs[i];
+    }
+
+    std::vector<uint8_t> payload;
+    payload.reserve((size_t)n * 3);
+    svb_encode(gaps, n, payload);
+    svb_encode(tfs, n, payload);
+
+    uint32_t header[2] = {docs[n - 1], (uint32_t)payload.size()};
+    size_t at = out.size();
+    out.resize(at + SVB_BLOCK_HEADER);
+    std::memcpy(out.data() + at, header, SVB_BLOCK_HEADER);
+    out.insert(out.end(), payload.begin(), payload.end());
+}
+
+// Data bytes used by n values, from their control bytes alone
+inline size_t svb_data_len(const uint8_t* ctrl, uint32_t n) {
+    size_t len = n;
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        uint8_t c = ctrl[i / 4];
+        len += (c & 3) + ((c >> 2) & 3) + ((c >> 4) & 3) + (c >> 6);
+    }
+    for (; i < n; i++) len += (ctrl[i / 4] >> ((i % 4) * 2)) & 3;
+    return len;
+}
+
+// Scalar decode of n values; returns the end of the data bytes
+inline const uint8_t* svb_decode_scalar(const uint8_t* ctrl, const uint8_t* data,
+                                        uint32_t n, uint32_t* out) {
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t len = ((ctrl[i / 4] >> ((i % 4) * 2)) & 3) + 1;
+        uint32_t v = 0;
+        for (uint32_t b = 0; b < len; b++) v |= (uint32_t)data[b] << (8 * b);
+        out[i] = v;
+        data += len;
+    }
+    return data;
+}
+
+#ifdef POSTINGS_CODEC_SSSE3
+// Per control byte: pshufb mask placing 4 values into 4 u32 lanes, and the
+// number of data bytes those 4 values use
+struct SvbTables {
+    alignas(16) uint8_t shuffle[256][16];
+    uint8_t length[256];
+
+    SvbTables() {
+        for (uint32_t c = 0; c < 256; c++) {
+            uint8_t off = 0;
+            for (uint32_t i = 0; i < 4; i++) {
+                uint32_t len = ((c >> (i * 2)) & 3) + 1;
+                for (uint32_t b = 0; b < 4; b++) {
+                    shuffle[c][i * 4 + b] = (b < len) ? (uint8_t)(off + b) : 0x80;
+                }
+                off = (uint8_t)(off + len);
+            }
+            length[c] = off;
+        }
+    }
+};
+
+inline const SvbTables& svb_tables() {
+    static const SvbTables t;
+    return t;
+}
+
+// SSSE3 decode: one shuffle per 4 values, scalar tail
+__attribute__((target("ssse3")))
+inline const uint8_t* svb_decode_ssse3(const uint8_t* ctrl, const uint8_t* data,
+                                       uint32_t n, uint32_t* out) {
+    const SvbTables& t = svb_tables();
+    uint32_t quads = n / 4;
+    for (uint32_t q = 0; q < quads; q++) {
+        uint8_t c = ctrl[q];
+        __m128i in = _mm_loadu_si128((const __m128i*)data);
+        __m128i mask = _mm_load_si128((const __m128i*)t.shuffle[c]);
+        _mm_storeu_si128((__m128i*)(out + q * 4), _mm_shuffle_epi8(in, mask));
+        data += t.length[c];
+    }
+    return svb_decode_scalar(ctrl + quads, data, n - quads * 4, out + quads * 4);
+}
+
+// In-place prefix sum of docId gaps, 4 lanes at a time
+__attribute__((target("ssse3")))
+inline void svb_prefix_sum_ssse3(uint32_t* v, uint32_t n, uint32_t base) {
+    __m128i carry = _mm_set1_epi32((int)base);
+    uint32_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i*)(v + i));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, carry);
+        _mm_storeu_si128((__m128i*)(v + i), x);
+        carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+    uint32_t prev = (uint32_t)_mm_cvtsi128_si32(carry);
+    for (; i < n; i++) {
+        prev += v[i];
+        v[i] = prev;
+    }
+}
+
+inline bool svb_use_ssse3() {
+    static const bool ok = __builtin_cpu_supports("ssse3");
+    return ok;
+}
+#endif
+
+// Decode n values (data must be followed by SVB_PADDING readable bytes)
+inline const uint8_t* svb_decode(const uint8_t* ctrl, const uint8_t* data,
+                                 uint32_t n, uint32_t* out) {
+#ifdef POSTINGS_CODEC_SSSE3
+    if (svb_use_ssse3()) return svb_decode_ssse3(ctrl, data, n, out);
+#endif
+    return svb_decode_scalar(ctrl, data, n, out);
+}
+
+// Turn docId gaps back into docIds
+inline void svb_prefix_sum(uint32_t* v, uint32_t n, uint32_t base) {
+#ifdef POSTINGS_CODEC_SSSE3
+    if (svb_use_ssse3()) { svb_prefix_sum_ssse3(v, n, base); return; }
+#endif
+    uint32_t prev = base;
+    for (uint32_t i = 0; i < n; i++) {
+        prev += v[i];
+        v[i] = prev;
+    }
+}
+
+// Decode one block payload into docIds and tfs (n postings)
+inline bool svb_decode_block(const uint8_t* payload, uint32_t payload_len, uint32_t n,
+                             uint32_t prev_last_doc, uint32_t* docs, uint32_t* tfs) {
+    uint32_t ctrl_len = (n + 3) / 4;
+    if (payload_len < 2 * ctrl_len) return false;
+
+    // Both streams must fit the payload before anything is decoded
+    const uint8_t* doc_ctrl = payload;
+    size_t doc_len = svb_data_len(doc_ctrl, n);
+    if (doc_len > payload_len - 2 * ctrl_len) return false;
+    const uint8_t* tf_ctrl = doc_ctrl + ctrl_len + doc_len;
+    if (svb_data_len(tf_ctrl, n) != payload_len - 2 * ctrl_len - doc_len) return false;
+
+    svb_decode(doc_ctrl, doc_ctrl + ctrl_len, n, docs);
+    svb_decode(tf_ctrl, tf_ctrl + ctrl_len, n, tfs);
+    svb_prefix_sum(docs, n, prev_last_doc);
+    return true;
+}
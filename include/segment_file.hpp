@@ -0,0 +1,327 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+// Single-file segment container (segment format v2).
+//
+// segment.seg holds what used to be a segment's loose files, one section per
+// file under the same name ("stats.bin", "inverted_b000.bin", ...), so every
+// per-file format stays unchanged. Layout:
+//   header (64 bytes, SegmentHeader)
+//   sections, each starting on a SEGMENT_ALIGN boundary (zero padding between)
+//   section table (SegmentSection[section_count]), SEGMENT_ALIGN aligned
+// Every section carries a CRC-32 of its bytes, the table has its own CRC and
+// the header checks itself. The server checks the header, the table and the
+// small sections when it opens a segment and the bulk sections before the
+// segment is published, so a damaged file is never scored.
+
+static constexpr char SEGMENT_MAGIC[8] = {'N', 'X', 'S', 'E', 'G', 'M', 'N', 'T'};
+static constexpr uint32_t SEGMENT_FORMAT_VERSION = 2;
+static constexpr uint64_t SEGMENT_ALIGN = 64;
+static constexpr size_t SEGMENT_NAME_LEN = 40;  // includes the terminating NUL
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t table_offset;
+    uint64_t file_size;
+    uint32_t table_crc;
+    uint32_t header_crc;  // CRC-32 of the bytes before this field
+    uint8_t reserved[24];
+};
+static_assert(sizeof(SegmentHeader) == 64, "SegmentHeader is written as raw bytes");
+
+struct SegmentSection {
+    char name[SEGMENT_NAME_LEN];
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc;
+    uint32_t reserved;
+};
+static_assert(sizeof(SegmentSection) == 64, "SegmentSection is written as raw bytes");
+
+// Path of the container inside a segment directory
+inline fs::path segment_file_path(const fs::path& segdir) {
+    return segdir / "segment.seg";
+}
+
+inline bool has_segment_file(const fs::path& segdir) {
+    return fs::exists(segment_file_path(segdir));
+}
+
+// CRC-32 (IEEE, reflected); pass the previous result to continue a running CRC
+inline uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t n) {
+    static const std::array<uint32_t, 256> table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+            t[i] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t segment_header_crc(const SegmentHeader& h) {
+    return crc32_update(0, (const uint8_t*)&h, offsetof(SegmentHeader, header_crc));
+}
+
+// Check the header against the real file size
+inline bool check_segment_header(const SegmentHeader& h, uint64_t file_size, std::string& err) {
+    if (std::memcmp(h.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC)) != 0) { err = "not a segment file"; return false; }
+    if (h.header_crc != segment_header_crc(h)) { err = "header checksum mismatch"; return false; }
+    if (h.version != SEGMENT_FORMAT_VERSION) { err = "unsupported segment version " + std::to_string(h.version); return false; }
+    if (h.file_size != file_size) { err = "file size does not match header (truncated?)"; return false; }
+    uint64_t table_bytes = (uint64_t)h.section_count * sizeof(SegmentSection);
+    if (h.table_offset < sizeof(SegmentHeader) || h.table_offset > file_size ||
+        table_bytes > file_size - h.table_offset) {
+        err = "section table out of range";
+        return false;
+    }
+    return true;
+}
+
+// Check the table checksum and that every section is aligned, named and in range
+inline bool check_segment_table(const SegmentHeader& h, const std::vector<SegmentSection>& secs,
+                                std::string& err) {
+    uint32_t crc = crc32_update(0, (const uint8_t*)secs.data(), secs.size() * sizeof(SegmentSection));
+    if (crc != h.table_crc) { err = "section table checksum mismatch"; return false; }
+    for (const auto& s : secs) {
+        // Names become file names on unpack: no paths, no empty names
+        if (s.name[SEGMENT_NAME_LEN - 1] != '\0' || s.name[0] == '\0' ||
+            std::strpbrk(s.name, "/\\") || std::strcmp(s.name, "..") == 0 || std::strcmp(s.name, ".") == 0) {
+            err = "bad section name";
+            return false;
+        }
+        if (s.offset % SEGMENT_ALIGN != 0 || s.offset < sizeof(SegmentHeader) ||
+            s.offset > h.table_offset || s.size > h.table_offset - s.offset) {
+            err = std::string("section out of range: ") + s.name;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read and validate header + table through a stream (tools; the server maps the file)
+inline bool read_segment_table(std::ifstream& in, uint64_t file_size, SegmentHeader& h,
+                               std::vector<SegmentSection>& secs, std::string& err) {
+    in.seekg(0, std::ios::beg);
+    if (!in.read((char*)&h, sizeof(h))) { err = "file too short for a segment header"; return false; }
+    if (!check_segment_header(h, file_size, err)) return false;
+    secs.resize(h.section_count);
+    in.seekg((std::streamoff)h.table_offset, std::ios::beg);
+    if (!in.read((char*)secs.data(), (std::streamsize)(secs.size() * sizeof(SegmentSection)))) {
+        err = "failed to read section table";
+        return false;
+    }
+    return check_segment_table(h, secs, err);
+}
+
+// Copy `size` bytes from in to out (out may be null), returning their CRC-32
+inline bool copy_with_crc(std::ifstream& in, std::ofstream* out, uint64_t size, uint32_t& crc) {
+    std::vector<char> buf(1 << 20);
+    crc = 0;
+    while (size > 0) {
+        size_t n = (size_t)std::min<uint64_t>(size, buf.size());
+        if (!in.read(buf.data(), (std::streamsize)n)) return false;
+        crc = crc32_update(crc, (const uint8_t*)buf.data(), n);
+        if (out && !out->write(buf.data(), (std::streamsize)n)) return false;
+        size -= n;
+    }
+    return true;
+}
+
+// Verify every section checksum of segdir/segment.seg
+inline bool verify_segment_file(const fs::path& segdir, std::string& err,
+                                std::vector<SegmentSection>* sections = nullptr) {
+    fs::path path = segment_file_path(segdir);
+    std::error_code ec;
+    uint64_t file_size = fs::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in) { err = "cannot open " + path.string(); return false; }
+
+    SegmentHeader h;
+    std::vector<SegmentSection> secs;
+    if (!read_segment_table(in, file_size, h, secs, err)) return false;
+    for (const auto& s : secs) {
+        uint32_t crc = 0;
+        in.seekg((std::streamoff)s.offset, std::ios::beg);
+        if (!copy_with_crc(in, nullptr, s.size, crc)) { err = std::string("failed to read ") + s.name; return false; }
+        if (crc != s.crc) { err = std::string("checksum mismatch in ") + s.name; return false; }
+    }
+    if (sections) *sections = std::move(secs);
+    return true;
+}
+
+// Names and sizes of a segment's files, packed or loose
+inline bool list_segment_files(const fs::path& segdir, std::vector<SegmentSection>& out, std::string& err) {
+    out.clear();
+    if (has_segment_file(segdir)) {
+        fs::path path = segment_file_path(segdir);
+        std::error_code ec;
+        uint64_t file_size = fs::file_size(path, ec);
+        std::ifstream in(path, std::ios::binary);
+        if (ec || !in) { err = "cannot open " + path.string(); return false; }
+        SegmentHeader h;
+        return read_segment_table(in, file_size, h, out, err);
+    }
+    for (const auto& e : fs::directory_iterator(segdir)) {
+        std::string name = e.path().filename().string();
+        if (!e.is_regular_file() || name.size() >= SEGMENT_NAME_LEN) continue;
+        SegmentSection s{};
+        std::memcpy(s.name, name.data(), name.size());
+        s.size = e.file_size();
+        out.push_back(s);
+    }
+    std::sort(out.begin(), out.end(),
+              [](const SegmentSection& a, const SegmentSection& b) { return std::strcmp(a.name, b.name) < 0; });
+    return true;
+}
+
+// Read one file of a segment, packed (checksum verified) or loose
+inline bool read_segment_bytes(const fs::path& segdir, const std::string& name,
+                               std::vector<char>& out, std::string& err) {
+    out.clear();
+    if (!has_segment_file(segdir)) {
+        std::ifstream in(segdir / name, std::ios::binary);
+        if (!in) { err = "cannot open " + name; return false; }
+        out.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    fs::path path = segment_file_path(segdir);
+    std::error_code ec;
+    uint64_t file_size = fs::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in) { err = "cannot open " + path.string(); return false; }
+    SegmentHeader h;
+    std::vector<SegmentSection> secs;
+    if (!read_segment_table(in, file_size, h, secs, err)) return false;
+    for (const auto& s : secs) {
+        if (name != s.name) continue;
+        out.resize(s.size);
+        in.seekg((std::streamoff)s.offset, std::ios::beg);
+        if (!in.read(out.data(), (std::streamsize)s.size)) { err = "failed to read " + name; return false; }
+        if (crc32_update(0, (const uint8_t*)out.data(), out.size()) != s.crc) {
+            err = "checksum mismatch in " + name;
+            return false;
+        }
+        return true;
+    }
+    err = "no section " + name;
+    return false;
+}
+
+// Pack every loose file of segdir into segment.seg, then delete the loose
+// files. The container is written to a temp file and renamed into place, so
+// a crash leaves either the old files or the complete container.
+inline bool pack_segment(const fs::path& segdir, std::string& err) {
+    std::vector<fs::path> files;
+    for (const auto& e : fs::directory_iterator(segdir)) {
+        if (!e.is_regular_file()) continue;
+        std::string name = e.path().filename().string();
+        // live.bin (deletes) stays beside the container: it keeps changing
+        if (name == "segment.seg" || name == "live.bin" || e.path().extension() == ".tmp") continue;
+        if (name.size() >= SEGMENT_NAME_LEN) { err = "file name too long for a section: " + name; return false; }
+        files.push_back(e.path());
+    }
+    std::sort(files.begin(), files.end());
+
+    fs::path final_path = segment_file_path(segdir);
+    fs::path tmp_path = final_path;
+    tmp_path += ".tmp";
+
+    std::ofstream out(tmp_path, std::ios::binary);
+    if (!out) { err = "failed to open " + tmp_path.string(); return false; }
+
+    SegmentHeader h{};
+    out.write((const char*)&h, sizeof(h));
+    uint64_t at = sizeof(h);
+
+    auto pad_to_align = [&]() {
+        static const char zeros[SEGMENT_ALIGN] = {};
+        uint64_t pad = (SEGMENT_ALIGN - at % SEGMENT_ALIGN) % SEGMENT_ALIGN;
+        out.write(zeros, (std::streamsize)pad);
+        at += pad;
+    };
+
+    std::vector<SegmentSection> secs;
+    for (const auto& p : files) {
+        pad_to_align();
+        SegmentSection s{};
+        std::string name = p.filename().string();
+        std::memcpy(s.name, name.data(), name.size());
+        s.offset = at;
+        s.size = fs::file_size(p);
+
+        std::ifstream in(p, std::ios::binary);
+        if (!in || !copy_with_crc(in, &out, s.size, s.crc)) {
+            err = "failed to copy " + name;
+            return false;
+        }
+        at += s.size;
+        secs.push_back(s);
+    }
+
+    pad_to_align();
+    h.table_offset = at;
+    out.write((const char*)secs.data(), (std::streamsize)(secs.size() * sizeof(SegmentSection)));
+    at += secs.size() * sizeof(SegmentSection);
+
+    std::memcpy(h.magic, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    h.version = SEGMENT_FORMAT_VERSION;
+    h.section_count = (uint32_t)secs.size();
+    h.file_size = at;
+    h.table_crc = crc32_update(0, (const uint8_t*)secs.data(), secs.size() * sizeof(SegmentSection));
+    h.header_crc = segment_header_crc(h);
+    out.seekp(0, std::ios::beg);
+    out.write((const char*)&h, sizeof(h));
+    out.close();
+    if (!out) { err = "failed to write " + tmp_path.string(); return false; }
+
+    std::error_code ec;
+    fs::rename(tmp_path, final_path, ec);
+    if (ec) { err = "failed to rename " + tmp_path.string() + ": " + ec.message(); return false; }
+
+    for (const auto& p : files) fs::remove(p, ec);
+    return true;
+}
+
+// Extract every section of segment.seg back into loose files (checksums
+// verified) and delete the container; used to rebuild a packed segment
+inline bool unpack_segment(const fs::path& segdir, std::string& err) {
+    fs::path path = segment_file_path(segdir);
+    std::error_code ec;
+    uint64_t file_size = fs::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    if (ec || !in) { err = "cannot open " + path.string(); return false; }
+
+    SegmentHeader h;
+    std::vector<SegmentSection> secs;
+    if (!read_segment_table(in, file_size, h, secs, err)) return false;
+    for (const auto& s : secs) {
+        std::ofstream out(segdir / s.name, std::ios::binary);
+        uint32_t crc = 0;
+        in.seekg((std::streamoff)s.offset, std::ios::beg);
+        if (!out || !copy_with_crc(in, &out, s.size, crc)) { err = std::string("failed to extract ") + s.name; return false; }
+        if (crc != s.crc) { err = std::string("checksum mismatch in ") + s.name; return false; }
+    }
+    in.close();
+    fs::remove(path, ec);
+    return true;
+}
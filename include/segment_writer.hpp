@@ -7,12 +7,11 @@
 #include <filesystem>
 
 #include "indexio.hpp"
-#include "barrels.hpp"
+#include "barrel_writer.hpp"
+#include "segment_file.hpp"
 
 namespace fs = std::filesystem;
 
-struct Posting { uint32_t docId; uint32_t tf; };
-
 struct DocMeta {
     std::string cord_uid;
     std::string title;
@@ -32,6 +31,11 @@ public:
     // inverted[termId] = postings
     std::vector<std::vector<Posting>> inverted;
 
+    // positions[termId] = token positions of each posting, in posting order.
+    // Only written when every document was added with positions.
+    std::vector<std::vector<uint32_t>> positions;
+    bool all_positional = true;
+
     std::vector<DocMeta> docs;
     uint64_t total_len = 0;
 
@@ -42,10 +46,12 @@ public:
         term_to_id.emplace(term, id);
         id_to_term.push_back(term);
         inverted.emplace_back();
+        positions.emplace_back();
         return id;
     }
 
     void add_document(const DocMeta& meta, const std::vector<std::pair<std::string,uint32_t>>& term_freqs) {
+        all_positional = false;
         uint32_t docId = (uint32_t)docs.size();
         docs.push_back(meta);
         total_len += meta.doc_len;
@@ -62,8 +68,31 @@ public:
         forward.push_back(std::move(fwd));
     }
 
-    void write_segment(const fs::path& segdir) {
-        fs::create_directories(segdir);
+    // Same as above, with each term's token positions in the doc (ascending)
+    void add_document(const DocMeta& meta, const std::vector<std::pair<std::string,std::vector<uint32_t>>>& term_positions) {
+        uint32_t docId = (uint32_t)docs.size();
+        docs.push_back(meta);
+        total_len += meta.doc_len;
+
+        std::vector<std::pair<uint32_t,uint32_t>> fwd;
+        fwd.reserve(term_positions.size());
+
+        for (auto& [term, plist] : term_positions) {
+            uint32_t tid = intern_term(term);
+            uint32_t tf = (uint32_t)plist.size();
+            fwd.push_back({tid, tf});
+            inverted[tid].push_back(Posting{docId, tf});
+            positions[tid].insert(positions[tid].end(), plist.begin(), plist.end());
+        }
+        std::sort(fwd.begin(), fwd.end());
+        forward.push_back(std::move(fwd));
+    }
+
+    // False (with err) if any file could not be written
+    bool write_segment(const fs::path& segdir, std::string& err) {
+        std::error_code ec;
+        fs::create_directories(segdir, ec);
+        if (ec) { err = "cannot create " + segdir.string(); return false; }
 
         float avgdl = docs.empty() ? 0.0f : (float)total_len / (float)docs.size();
 
@@ -72,6 +101,7 @@ public:
             std::ofstream out(segdir / "stats.bin", std::ios::binary);
             write_u32(out, (uint32_t)docs.size());
             write_f32(out, avgdl);
+            if (!out) { err = "failed to write stats.bin"; return false; }
         }
 
         // docs.bin
@@ -84,6 +114,7 @@ public:
                 write_string(out, d.json_relpath);
                 write_u32(out, d.doc_len);
             }
+            if (!out) { err = "failed to write docs.bin"; return false; }
         }
 
         // forward.bin
@@ -98,6 +129,7 @@ public:
                     write_u32(out, tf);
                 }
             }
+            if (!out) { err = "failed to write forward.bin"; return false; }
         }
 
         // terms.bin
@@ -105,65 +137,21 @@ public:
             std::ofstream out(segdir / "terms.bin", std::ios::binary);
             write_u32(out, (uint32_t)id_to_term.size());
             for (auto& t : id_to_term) write_string(out, t);
+            if (!out) { err = "failed to write terms.bin"; return false; }
         }
 
-        // BARRELIZED inverted + lexicon
-        // Per-barrel lexicon entry format:
-        //   term(string), termId(u32), df(u32), offset(u64), count(u32)
+        // BARRELIZED inverted + lexicon (+ per-term bounds)
         {
-            BarrelParams bp;
-            bp.barrel_count = BARREL_COUNT;
-            uint32_t tcount = (uint32_t)id_to_term.size();
-            bp.terms_per_barrel = (tcount + bp.barrel_count - 1) / bp.barrel_count;
-            if (bp.terms_per_barrel == 0) bp.terms_per_barrel = 1;
-
-            write_barrels_manifest(segdir, bp);
-
-            std::vector<std::ofstream> inv(bp.barrel_count);
-            std::vector<std::ofstream> lex(bp.barrel_count);
-            std::vector<uint64_t> offsets(bp.barrel_count, 0);
-            std::vector<uint32_t> barrel_term_counts(bp.barrel_count, 0);
-
-            for (uint32_t b=0; b<bp.barrel_count; b++) {
-                inv[b].open(inv_barrel_path(segdir, b), std::ios::binary);
-                lex[b].open(lex_barrel_path(segdir, b), std::ios::binary);
-                write_u32(lex[b], 0); // placeholder
-            }
-
-            for (uint32_t tid=0; tid<tcount; tid++) {
-                auto& plist = inverted[tid];
-                if (plist.empty()) continue;
-
-                std::sort(plist.begin(), plist.end(),
-                          [](const Posting& a, const Posting& b){ return a.docId < b.docId; });
+            std::vector<uint32_t> doc_lens;
+            doc_lens.reserve(docs.size());
+            for (auto& d : docs) doc_lens.push_back(d.doc_len);
 
-                uint32_t df = (uint32_t)plist.size();
-                uint32_t b  = barrel_for_term(tid, bp);
+            bool with_positions = all_positional && !docs.empty();
 
-                barrel_term_counts[b]++;
-
-                write_string(lex[b], id_to_term[tid]);
-                write_u32(lex[b], tid);
-                write_u32(lex[b], df);
-                write_u64(lex[b], offsets[b]);
-                write_u32(lex[b], df);
-
-                for (auto& p : plist) {
-                    write_u32(inv[b], p.docId);
-                    write_u32(inv[b], p.tf);
-                }
-                offsets[b] += (uint64_t)df * (sizeof(uint32_t)*2);
-            }
-
-            // patch counts
-            for (uint32_t b=0; b<bp.barrel_count; b++) {
-                lex[b].flush();
-                lex[b].close();
-                std::ofstream patch(lex_barrel_path(segdir, b), std::ios::in | std::ios::out | std::ios::binary);
-                patch.seekp(0, std::ios::beg);
-                write_u32(patch, barrel_term_counts[b]);
-                patch.flush();
-            }
+            if (!write_barrelized_index(segdir, id_to_term, inverted, doc_lens, err,
+                                        with_positions ? &positions : nullptr))
+                return false;
+            return pack_segment(segdir, err);
         }
     }
 };
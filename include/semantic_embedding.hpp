@@ -1,6 +1,7 @@
 #pragma once
 
 #include <filesystem>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -29,9 +30,10 @@ struct SemanticIndex {
     //   word v1 v2 ... vD
     // Supports optional header line: "<vocab> <dim>".
     //
-    // To keep memory low, this loads vectors ONLY for `needed_terms`.
+    // To keep memory low, this loads vectors ONLY for words where
+    // `needed(word)` is true (every word when `needed` is empty).
     bool load_from_text(const fs::path& path,
-                        const std::unordered_set<std::string>& needed_terms);
+                        const std::function<bool(const std::string&)>& needed);
 
     // Expand query tokens by nearest neighbors in embedding space.
     // Returns (term, weight) pairs. Original query terms always have weight 1.0.
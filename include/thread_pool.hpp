@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cord19 {
+
+// Fixed-size worker pool.
+//
+// Tasks run in FIFO order on long-lived threads, so thread_local scratch
+// (e.g. score accumulators) is allocated once per worker, not per query.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    // Queue a task; the future rethrows anything the task throws
+    template <class F>
+    std::future<void> submit(F&& f) {
+        auto task = std::make_shared<std::packaged_task<void()>>(std::forward<F>(f));
+        std::future<void> fut = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks_.emplace_back([task]() { (*task)(); });
+        }
+        cv_.notify_one();
+        return fut;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+
+    void worker_loop();
+};
+
+// Run f(i) for every i in [0, n) on the calling thread and up to
+// pool->size() workers (inline when pool is null). Indices are claimed one
+// at a time, and the caller only waits for indices already being run, never
+// for queued helpers, so a task may itself call parallel_for on the same
+// pool. The first exception thrown by f is rethrown here.
+template <class F>
+void parallel_for(ThreadPool* pool, size_t n, const F& f) {
+    struct State {
+        std::atomic<size_t> next{0};
+        size_t done = 0;
+        std::exception_ptr error;
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+    auto st = std::make_shared<State>();
+
+    // A helper that starts after the last index was claimed touches only `st`
+    auto run = [st, n, &f]() {
+        size_t finished = 0;
+        std::exception_ptr error;
+        for (size_t i; (i = st->next.fetch_add(1)) < n; finished++) {
+            try {
+                f(i);
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        if (finished == 0) return;
+        std::lock_guard<std::mutex> lock(st->mtx);
+        if (error && !st->error) st->error = error;
+        st->done += finished;
+        if (st->done == n) st->cv.notify_all();
+    };
+
+    size_t helpers = pool && n > 1 ? std::min(pool->size(), n - 1) : 0;
+    for (size_t h = 0; h < helpers; h++) pool->submit(run);
+    run();
+
+    std::unique_lock<std::mutex> lock(st->mtx);
+    st->cv.wait(lock, [&]() { return st->done == n; });
+    if (st->error) std::rethrow_exception(st->error);
+}
+
+} // namespace cord19
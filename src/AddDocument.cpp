@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
@@ -9,6 +11,9 @@
 #include "cordjson.hpp"
 #include "textutil.hpp"
 #include "indexio.hpp"
+#include "index_lock.hpp"
+#include "live_docs.hpp"
+#include "segment_file.hpp"
 
 namespace fs = std::filesystem;
 
@@ -29,10 +34,27 @@ static std::vector<std::string> load_manifest(const fs::path& manifest_path) {
     return segs;
 }
 
+// Written to a temp file and renamed, so readers never see a partial list
 static void save_manifest(const fs::path& manifest_path, const std::vector<std::string>& segs) {
-    std::ofstream out(manifest_path, std::ios::binary);
-    write_u32(out, (uint32_t)segs.size());
-    for (auto& s : segs) write_string(out, s);
+    fs::path tmp = manifest_path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        write_u32(out, (uint32_t)segs.size());
+        for (auto& s : segs) write_string(out, s);
+    }
+    fs::rename(tmp, manifest_path);
+}
+
+// Next free segment number (merges replace segments, so the manifest size
+// is not a safe id)
+static uint32_t next_segment_id(const fs::path& segments_dir) {
+    uint32_t max_id = 1;
+    for (auto& e : fs::directory_iterator(segments_dir)) {
+        std::string name = e.path().filename().string();
+        if (name.rfind("seg_", 0) == 0) max_id = std::max(max_id, (uint32_t)std::strtoul(name.c_str() + 4, nullptr, 10));
+    }
+    return max_id + 1;
 }
 
 int main(int argc, char** argv) {
@@ -51,8 +73,24 @@ int main(int argc, char** argv) {
     fs::path segments_dir = index_dir / "segments";
     fs::create_directories(segments_dir);
 
+    // Held until exit: a running server's merges, flushes and deletes wait
+    // instead of swapping the manifest or live.bin files under this tool
+    IndexFileLock lock(index_dir);
+    if (!lock.locked()) {
+        std::cerr << "Cannot lock " << index_lock_path(index_dir) << "\n";
+        return 1;
+    }
+
+    // Without a manifest yet, the index is every seg_* folder (as the server reads it)
     auto segs = load_manifest(manifest);
-    uint32_t new_id = (uint32_t)segs.size() + 2;
+    if (segs.empty()) {
+        for (auto& e : fs::directory_iterator(segments_dir)) {
+            std::string name = e.path().filename().string();
+            if (e.is_directory() && name.rfind("seg_", 0) == 0) segs.push_back(name);
+        }
+        std::sort(segs.begin(), segs.end());
+    }
+    uint32_t new_id = next_segment_id(segments_dir);
     std::string new_seg = seg_name(new_id);
     fs::path segdir = segments_dir / new_seg;
     fs::create_directories(segdir);
@@ -164,10 +202,45 @@ int main(int argc, char** argv) {
         }
     }
 
+    // Pack into one checksummed segment.seg
+    {
+        std::string err;
+        if (!pack_segment(segdir, err)) {
+            std::cerr << err << " in: " << segdir << "\n";
+            return 1;
+        }
+    }
+
     // Update manifest
     segs.push_back(new_seg);
     save_manifest(manifest, segs);
 
+    // Re-adding a cord_uid updates it: older copies are marked deleted. The
+    // new copy is listed first, so the document is never missing.
+    size_t replaced = 0;
+    for (const auto& name : segs) {
+        if (name == new_seg) continue;
+        fs::path dir = segments_dir / name;
+        std::vector<std::string> uids;
+        LiveDocs live;
+        std::string err;
+        if (!read_doc_uids(dir, uids, err) || !read_live_docs(dir, (uint32_t)uids.size(), live, err)) {
+            std::cerr << "Cannot check " << name << " for older copies: " << err << "\n";
+            continue;
+        }
+        size_t removed = 0;
+        for (uint32_t d = 0; d < (uint32_t)uids.size(); d++) {
+            if (uids[d] == cord_uid && live.remove(d)) removed++;
+        }
+        if (removed == 0) continue;
+        if (!write_live_docs(dir, live, err)) {
+            std::cerr << err << "\n";
+            return 1;
+        }
+        replaced += removed;
+    }
+
     std::cout << "Added doc into segment: " << new_seg << "\n";
+    if (replaced > 0) std::cout << "Replaced " << replaced << " older copies of " << cord_uid << "\n";
     return 0;
 }
\ No newline at end of file
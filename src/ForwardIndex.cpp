@@ -64,6 +64,9 @@ int main(int argc, char** argv) {
     fs::path seg  = fs::path(argv[2]);
     fs::create_directories(seg);
 
+    // A container from an earlier build would shadow the files written here
+    fs::remove(seg / "segment.seg");
+
     // Locate metadata.csv
     fs::path meta = root / "metadata.csv";
     if (!fs::exists(meta)) {
@@ -105,6 +108,12 @@ int main(int argc, char** argv) {
     std::vector<std::vector<std::pair<uint32_t, uint32_t>>> forward;
     uint64_t total_len = 0;
 
+    // Token positions are streamed to forward_pos.bin as docs are parsed.
+    // Format: numDocs(u32); then for each doc and each forward.bin entry (same
+    // order), tf positions (u32, ascending). Positions count kept tokens only.
+    std::ofstream pos_out(seg / "forward_pos.bin", std::ios::binary);
+    write_u32(pos_out, 0); // placeholder, patched below
+
     std::string line;
     while (std::getline(in, line)) {
         if (line.empty()) continue;
@@ -138,15 +147,15 @@ int main(int argc, char** argv) {
 
         auto toks = tokenize(text);
 
-        // Build term frequency map
-        std::unordered_map<std::string, uint32_t> tf;
-        tf.reserve(toks.size() / 2 + 8);
+        // Build per-term position lists (tf = list size)
+        std::unordered_map<std::string, std::vector<uint32_t>> tpos;
+        tpos.reserve(toks.size() / 2 + 8);
 
         uint32_t doc_len = 0;
         for (auto& t : toks) {
             if (t.size() < 2) continue;
             if (is_stopword(t)) continue;
-            tf[t] += 1;
+            tpos[t].push_back(doc_len);
             doc_len += 1;
         }
         if (doc_len == 0) continue;
@@ -157,10 +166,10 @@ int main(int argc, char** argv) {
         total_len += doc_len;
 
         // Build forward postings for this doc
-        std::vector<std::pair<uint32_t, uint32_t>> postings;
-        postings.reserve(tf.size());
+        std::vector<std::pair<uint32_t, const std::vector<uint32_t>*>> by_tid;
+        by_tid.reserve(tpos.size());
 
-        for (auto& kv : tf) {
+        for (auto& kv : tpos) {
             auto it = term_to_id.find(kv.first);
             uint32_t tid;
 
@@ -172,10 +181,17 @@ int main(int argc, char** argv) {
                 tid = it->second;
             }
 
-            postings.push_back({tid, kv.second});
+            by_tid.push_back({tid, &kv.second});
         }
 
-        std::sort(postings.begin(), postings.end());
+        std::sort(by_tid.begin(), by_tid.end());
+
+        std::vector<std::pair<uint32_t, uint32_t>> postings;
+        postings.reserve(by_tid.size());
+        for (auto& [tid, plist] : by_tid) {
+            postings.push_back({tid, (uint32_t)plist->size()});
+            for (uint32_t p : *plist) write_u32(pos_out, p);
+        }
         forward.push_back(std::move(postings));
 
         // Progress logging
@@ -218,6 +234,11 @@ int main(int argc, char** argv) {
         }
     }
 
+    // Patch doc count in forward_pos.bin
+    pos_out.seekp(0, std::ios::beg);
+    write_u32(pos_out, (uint32_t)forward.size());
+    pos_out.close();
+
     // Write terms.bin
     {
         std::ofstream out(seg / "terms.bin", std::ios::binary);
@@ -227,7 +248,7 @@ int main(int argc, char** argv) {
     }
 
     // Final instructions
-    std::cerr << "Wrote forward+terms+docs+stats to segment: " << seg << "\n";
+    std::cerr << "Wrote forward+positions+terms+docs+stats to segment: " << seg << "\n";
     std::cerr << "Now run: lexicon.exe " << seg << "\n";
     return 0;
 }
@@ -15,17 +15,18 @@
 
 #include "api_http.hpp"
 #include "api_segment.hpp"
-#include "barrels.hpp"
+#include "barrel_writer.hpp"
 #include "cordjson.hpp"
 #include "indexio.hpp"
+#include "segment_file.hpp"
 #include "textutil.hpp"
 
 namespace cord19 {
 
 namespace fs = std::filesystem;
 
-// IMPORTANT: api_types.hpp already defines cord19::DocInfo,
-// so we must NOT redefine it here.
+// Per-document record for a parsed slice (segments keep doc columns
+// in cord19::Segment instead).
 struct SliceDocInfo {
     std::string cord_uid;
     std::string title;
@@ -420,9 +421,6 @@ static bool build_forward_terms_docs_stats_from_slice(
     return true;
 }
 
-// Posting list element
-struct Posting { uint32_t docId; uint32_t tf; };
-
 static bool build_barrelized_lexicon_from_forward(
     const fs::path& segdir,
     std::string& err
@@ -444,6 +442,21 @@ static bool build_barrelized_lexicon_from_forward(
         for (uint32_t i = 0; i < n; i++) terms[i] = read_string(in);
     }
 
+    // Load doc lengths for per-term bounds
+    std::vector<uint32_t> doc_lens;
+    {
+        std::ifstream in(segdir / "docs.bin", std::ios::binary);
+        if (!in) { err = "failed to open docs.bin"; return false; }
+        uint32_t n = read_u32(in);
+        doc_lens.resize(n);
+        for (uint32_t i = 0; i < n; i++) {
+            read_string(in);
+            read_string(in);
+            read_string(in);
+            doc_lens[i] = read_u32(in);
+        }
+    }
+
     // Build inverted postings
     std::vector<std::vector<Posting>> inverted(terms.size());
     {
@@ -462,67 +475,9 @@ static bool build_barrelized_lexicon_from_forward(
         }
     }
 
-    // Write barrelized inverted + lexicon
-    {
-        BarrelParams bp;
-        bp.barrel_count = BARREL_COUNT;
-        uint32_t tcount = (uint32_t)terms.size();
-        bp.terms_per_barrel = (tcount + bp.barrel_count - 1) / bp.barrel_count;
-        if (bp.terms_per_barrel == 0) bp.terms_per_barrel = 1;
-
-        write_barrels_manifest(segdir, bp);
-
-        std::vector<std::ofstream> inv(bp.barrel_count);
-        std::vector<std::ofstream> lex(bp.barrel_count);
-        std::vector<uint64_t> offsets(bp.barrel_count, 0);
-        std::vector<uint32_t> barrel_term_counts(bp.barrel_count, 0);
-
-        for (uint32_t b = 0; b < bp.barrel_count; b++) {
-            inv[b].open(inv_barrel_path(segdir, b), std::ios::binary);
-            lex[b].open(lex_barrel_path(segdir, b), std::ios::binary);
-            if (!inv[b] || !lex[b]) { err = "failed to open barrel files for writing"; return false; }
-            write_u32(lex[b], 0); // placeholder
-        }
-
-        for (uint32_t tid = 0; tid < tcount; tid++) {
-            auto& plist = inverted[tid];
-            if (plist.empty()) continue;
-
-            std::sort(plist.begin(), plist.end(),
-                      [](const Posting& a, const Posting& b){ return a.docId < b.docId; });
-
-            uint32_t df = (uint32_t)plist.size();
-            uint32_t b  = barrel_for_term(tid, bp);
-
-            barrel_term_counts[b]++;
-
-            write_string(lex[b], terms[tid]);
-            write_u32(lex[b], tid);
-            write_u32(lex[b], df);
-            write_u64(lex[b], offsets[b]);
-            write_u32(lex[b], df);
-
-            for (auto& p : plist) {
-                write_u32(inv[b], p.docId);
-                write_u32(inv[b], p.tf);
-            }
-            offsets[b] += (uint64_t)df * (sizeof(uint32_t) * 2);
-        }
-
-        for (uint32_t b = 0; b < bp.barrel_count; b++) {
-            lex[b].flush();
-            lex[b].close();
-
-            std::ofstream patch(lex_barrel_path(segdir, b),
-                                std::ios::in | std::ios::out | std::ios::binary);
-            if (!patch) { err = "failed to patch lexicon barrel"; return false; }
-            patch.seekp(0, std::ios::beg);
-            write_u32(patch, barrel_term_counts[b]);
-            patch.flush();
-        }
-    }
-
-    return true;
+    // Write barrelized inverted + lexicon, then pack into segment.seg
+    if (!write_barrelized_index(segdir, terms, inverted, doc_lens, err)) return false;
+    return pack_segment(segdir, err);
 }
 
 void handle_add_document(
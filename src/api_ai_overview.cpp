@@ -139,7 +139,7 @@ json generate_ai_overview(const AzureOpenAIConfig& config,
     if (engine) {
         std::string cache_key = engine->make_cache_key(query, k);
         
-        std::lock_guard<std::mutex> lock(engine->mtx);
+        std::lock_guard<std::mutex> lock(engine->cache_mtx);
         json cached = engine->get_ai_overview_from_cache(cache_key);
         
         if (!cached.is_null() && cached.contains("from_cache")) {
@@ -241,7 +241,7 @@ json generate_ai_overview(const AzureOpenAIConfig& config,
                 // Cache the successful response if engine is provided
                 if (engine) {
                     std::string cache_key = engine->make_cache_key(query, k);
-                    std::lock_guard<std::mutex> lock(engine->mtx);
+                    std::lock_guard<std::mutex> lock(engine->cache_mtx);
                     engine->put_ai_overview_in_cache(cache_key, response_json);
                     std::cerr << "[ai_overview] Cached AI overview for query: \"" << query << "\" k=" << k << "\n";
                 }
@@ -95,7 +95,7 @@ json generate_ai_summary(const AzureOpenAIConfig& config,
     if (engine) {
         std::string cache_key = "summary|" + cord_uid;
         
-        std::lock_guard<std::mutex> lock(engine->mtx);
+        std::lock_guard<std::mutex> lock(engine->cache_mtx);
         json cached = engine->get_ai_summary_from_cache(cache_key);
         
         if (!cached.is_null() && cached.contains("from_cache")) {
@@ -118,7 +118,8 @@ json generate_ai_summary(const AzureOpenAIConfig& config,
     
     try {
         // Look up metadata byte position for the cord_uid
-        if (!engine || engine->uid_to_meta.find(cord_uid) == engine->uid_to_meta.end()) {
+        auto snap = engine ? engine->snapshot() : nullptr;
+        if (!snap || snap->uid_to_meta->find(cord_uid) == snap->uid_to_meta->end()) {
             response_json["error"] = "cord_uid not found in metadata";
             response_json["success"] = false;
             response_json["cord_uid"] = cord_uid;
@@ -127,8 +128,8 @@ json generate_ai_summary(const AzureOpenAIConfig& config,
         }
         
         // Fetch actual metadata on-demand from file
-        const auto& meta_info = engine->uid_to_meta.at(cord_uid);
-        MetaData meta = fetch_metadata(engine->metadata_csv_path, meta_info);
+        const auto& meta_info = snap->uid_to_meta->at(cord_uid);
+        MetaData meta = snap->metadata->fetch(meta_info);
         
         // Check if abstract exists
         if (meta.abstract.empty()) {
@@ -222,7 +223,7 @@ json generate_ai_summary(const AzureOpenAIConfig& config,
                 // Cache the successful response if engine is provided
                 if (engine) {
                     std::string cache_key = "summary|" + cord_uid;
-                    std::lock_guard<std::mutex> lock(engine->mtx);
+                    std::lock_guard<std::mutex> lock(engine->cache_mtx);
                     engine->put_ai_summary_in_cache(cache_key, response_json);
                     std::cerr << "[ai_summary] Cached AI summary for cord_uid: \"" << cord_uid << "\"\n";
                 }
@@ -4,19 +4,21 @@
 #include <cctype>
 #include <string>
 
+#include "indexio.hpp"
+
 namespace cord19 {
 
 // Clear all autocomplete data and reset defaults
 void AutocompleteIndex::clear() {
-    nodes_.clear();
-    terms_.clear();
-    scores_.clear();
+    dicts_.clear();
+    short_top_.clear();
+    has_terms_ = false;
     max_top_ = 10;
 }
 
 // Check if autocomplete index is empty
 bool AutocompleteIndex::empty() const {
-    return terms_.empty();
+    return !has_terms_;
 }
 
 // Normalize token by keeping only lowercase alphanumeric characters
@@ -29,124 +31,118 @@ std::string AutocompleteIndex::normalize_token(const std::string& s) {
     return out;
 }
 
-// Update top candidate list for a prefix node
-void AutocompleteIndex::update_top(std::vector<Cand>& top, const Cand& c) const {
-
-    // Remove duplicate term entries and keep higher score
-    for (auto& existing : top) {
-        if (existing.term_index == c.term_index) {
-            if (c.score > existing.score) existing.score = c.score;
-            goto sort_and_trim;
-        }
-    }
-
-    // Add new candidate if not already present
-    top.push_back(c);
-
-sort_and_trim:
-    // Sort candidates by score and then alphabetically
-    std::stable_sort(top.begin(), top.end(), [&](const Cand& a, const Cand& b) {
-        if (a.score != b.score) return a.score > b.score;
-        return terms_[a.term_index] < terms_[b.term_index];
-    });
-
-    // Keep only top N candidates
-    if (top.size() > max_top_) top.resize(max_top_);
+// Offer a term to a top candidate list (each term is offered once)
+void AutocompleteIndex::update_top(std::vector<Cand>& top, std::string_view term, uint64_t score) const {
+
+    // Skip terms that rank below a full list
+    auto ranks_before = [](uint64_t sa, std::string_view ta, const Cand& b) {
+        if (sa != b.score) return sa > b.score;
+        return ta < b.term;
+    };
+    if (top.size() >= max_top_ && !ranks_before(score, term, top.back())) return;
+
+    // Insert by score and then alphabetically, keeping only top N candidates
+    auto at = std::find_if(top.begin(), top.end(),
+                           [&](const Cand& c) { return ranks_before(score, term, c); });
+    top.insert(at, Cand{std::string(term), score});
+    if (top.size() > max_top_) top.pop_back();
 }
 
-// Insert a term into the autocomplete trie
-void AutocompleteIndex::insert_term(uint32_t term_index) {
-    const std::string& term = terms_[term_index];
-    uint32_t score = scores_[term_index];
-
-    // Start from root node
-    uint32_t node = 0;
-
-    // Update root suggestions
-    update_top(nodes_[node].top, Cand{term_index, score});
-
-    // Walk through each character of the term
-    for (unsigned char uc : term) {
-        char c = (char)uc;
-        auto it = nodes_[node].next.find(c);
-
-        // Create new node if path does not exist
-        if (it == nodes_[node].next.end()) {
-            uint32_t new_node = (uint32_t)nodes_.size();
-            nodes_.push_back(Node{});
-            nodes_[node].next.emplace(c, new_node);
-            node = new_node;
-        } else {
-            node = it->second;
-        }
-
-        // Update suggestions for this prefix
-        update_top(nodes_[node].top, Cand{term_index, score});
-    }
+// Collect the top candidates for a long prefix by scanning its term range
+void AutocompleteIndex::scan_top(const std::string& prefix_norm, std::vector<Cand>& top) const {
+    scan_prefix(dicts_, prefix_norm, [&](std::string_view term, uint64_t df) {
+        if (term.size() >= 2) update_top(top, term, df);
+        return true;
+    });
 }
 
-// Build autocomplete index from term-to-score map
-void AutocompleteIndex::build(const std::unordered_map<std::string, uint32_t>& term_to_score,
+// Build autocomplete index from the segments' term dictionaries
+void AutocompleteIndex::build(std::vector<const TermDictionary*> dicts,
                              size_t max_candidates_per_prefix) {
 
     // Reset existing data
     clear();
     max_top_ = std::max<size_t>(1, max_candidates_per_prefix);
-
-    // Reserve memory for performance
-    terms_.reserve(term_to_score.size());
-    scores_.reserve(term_to_score.size());
-    nodes_.reserve(1 + term_to_score.size() * 2);
-
-    // Create root trie node
-    nodes_.push_back(Node{});
-
-    // Normalize and store valid terms
-    for (const auto& kv : term_to_score) {
-        std::string t = normalize_token(kv.first);
-        if (t.size() < 2) continue;
-        terms_.push_back(std::move(t));
-        scores_.push_back(kv.second);
-    }
-
-    // Create index order sorted by score and term
-    std::vector<uint32_t> order(terms_.size());
-    for (uint32_t i = 0; i < (uint32_t)order.size(); i++) order[i] = i;
-
-    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
-        if (scores_[a] != scores_[b]) return scores_[a] > scores_[b];
-        return terms_[a] < terms_[b];
+    dicts_ = std::move(dicts);
+
+    // One merged pass over all terms fills the short-prefix top lists
+    scan_prefix(dicts_, "", [&](std::string_view term, uint64_t df) {
+        if (term.size() < 2) return true;
+        has_terms_ = true;
+        for (size_t len = 1; len <= SHORT_PREFIX; len++) {
+            update_top(short_top_[std::string(term.substr(0, len))], term, df);
+        }
+        return true;
     });
+}
 
-    // Reorder terms and scores for deterministic output
-    std::vector<std::string> terms2;
-    std::vector<uint32_t> scores2;
-    terms2.reserve(terms_.size());
-    scores2.reserve(scores_.size());
-
-    for (uint32_t idx : order) {
-        terms2.push_back(std::move(terms_[idx]));
-        scores2.push_back(scores_[idx]);
-    }
-
-    terms_.swap(terms2);
-    scores_.swap(scores2);
+// Rescore only the added terms: their df summed over every dictionary
+void AutocompleteIndex::add_dictionaries(std::vector<const TermDictionary*> dicts,
+                                         const std::vector<const TermDictionary*>& added) {
+    dicts_ = std::move(dicts);
+
+    scan_prefix(added, "", [&](std::string_view term, uint64_t) {
+        if (term.size() < 2) return true;
+        has_terms_ = true;
+
+        // The exact term comes first in its own prefix range
+        uint64_t df = 0;
+        scan_prefix(dicts_, term, [&](std::string_view t, uint64_t d) {
+            if (t == term) df = d;
+            return false;
+        });
+
+        // Re-offer the term with its new score
+        for (size_t len = 1; len <= SHORT_PREFIX; len++) {
+            auto& top = short_top_[std::string(term.substr(0, len))];
+            top.erase(std::remove_if(top.begin(), top.end(),
+                                     [&](const Cand& c) { return c.term == term; }),
+                      top.end());
+            update_top(top, term, df);
+        }
+        return true;
+    });
+}
 
-    // Insert all terms into the trie
-    for (uint32_t i = 0; i < (uint32_t)terms_.size(); i++) {
-        insert_term(i);
+// Layout: u32 max_top, u32 has_terms, u32 prefix count, then per prefix its
+// string and u32 count of (string term, u64 score)
+void AutocompleteIndex::save(std::ofstream& out) const {
+    write_u32(out, (uint32_t)max_top_);
+    write_u32(out, has_terms_ ? 1 : 0);
+    write_u32(out, (uint32_t)short_top_.size());
+    for (const auto& [prefix, top] : short_top_) {
+        write_string(out, prefix);
+        write_u32(out, (uint32_t)top.size());
+        for (const auto& c : top) {
+            write_string(out, c.term);
+            write_u64(out, c.score);
+        }
     }
 }
 
-// Find trie node for a given normalized prefix
-bool AutocompleteIndex::lookup_node(const std::string& prefix_norm, uint32_t& node_id) const {
-    node_id = 0;
-    for (unsigned char uc : prefix_norm) {
-        char c = (char)uc;
-        auto it = nodes_[node_id].next.find(c);
-        if (it == nodes_[node_id].next.end()) return false;
-        node_id = it->second;
+bool AutocompleteIndex::load(std::vector<const TermDictionary*> dicts, ByteReader& in) {
+    clear();
+    max_top_ = std::max<size_t>(1, in.u32());
+    has_terms_ = in.u32() != 0;
+    uint32_t prefixes = in.u32();
+    for (uint32_t i = 0; i < prefixes && in.ok(); i++) {
+        auto& top = short_top_[in.str()];
+        uint32_t n = in.u32();
+        if (n > max_top_) {
+            clear();
+            return false;
+        }
+        top.resize(n);
+        for (auto& c : top) {
+            c.term = in.str();
+            c.score = in.u64();
+        }
     }
+    if (!in.ok() || short_top_.size() != prefixes) {
+        clear();
+        return false;
+    }
+    dicts_ = std::move(dicts);
     return true;
 }
 
@@ -172,18 +168,24 @@ std::vector<std::string> AutocompleteIndex::suggest_query(const std::string& use
     std::string prefix = normalize_token(last);
     if (prefix.empty()) return out;
 
-    // Locate trie node for prefix
-    uint32_t node = 0;
-    if (!lookup_node(prefix, node)) return out;
+    // Precomputed list for short prefixes, range scan for longer ones
+    std::vector<Cand> scanned;
+    const std::vector<Cand>* top = &scanned;
+    if (prefix.size() <= SHORT_PREFIX) {
+        auto it = short_top_.find(prefix);
+        if (it == short_top_.end()) return out;
+        top = &it->second;
+    } else {
+        scan_top(prefix, scanned);
+    }
 
     // Collect top suggestions
-    const auto& top = nodes_[node].top;
-    size_t m = std::min(limit, top.size());
+    size_t m = std::min(limit, top->size());
     out.reserve(m);
 
     // Build final suggestion strings
     for (size_t i = 0; i < m; i++) {
-        out.push_back(base + terms_[top[i].term_index]);
+        out.push_back(base + (*top)[i].term);
     }
 
     return out;
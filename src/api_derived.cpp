@@ -0,0 +1,240 @@
+#include "api_derived.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <system_error>
+
+#include "indexio.hpp"
+
+namespace cord19 {
+
+// Every derived file: header (32 bytes), then the structure's payload
+static constexpr char DERIVED_MAGIC[8] = {'N', 'X', 'D', 'R', 'V', '0', '0', '1'};
+static constexpr uint32_t DERIVED_VERSION = 1;
+
+struct DerivedHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t payload_size;
+};
+static_assert(sizeof(DerivedHeader) == 32, "DerivedHeader is written as raw bytes");
+
+// FNV-1a over the fields identifying an input
+struct KeyHasher {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    void add(const void* p, size_t n) {
+        const uint8_t* b = (const uint8_t*)p;
+        for (size_t i = 0; i < n; i++) {
+            h ^= b[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    void add_u64(uint64_t v) { add(&v, sizeof(v)); }
+    void add_str(const std::string& s) {
+        add_u64(s.size());
+        add(s.data(), s.size());
+    }
+    void add_stamp(const FileStamp& st) {
+        add_u64(st.size);
+        add_u64((uint64_t)st.mtime);
+    }
+
+    // 0 is reserved for "nothing to save"
+    uint64_t key() const { return h ? h : 1; }
+};
+
+uint64_t metadata_key(const FileStamp& csv) {
+    if (!csv.exists) return 0;
+    KeyHasher k;
+    k.add_str("metadata");
+    k.add_u64(DERIVED_VERSION);
+    k.add_stamp(csv);
+    return k.key();
+}
+
+uint64_t segments_key(const std::vector<std::string>& seg_names, const std::vector<SegmentPtr>& segments) {
+    KeyHasher k;
+    k.add_str("segments");
+    k.add_u64(DERIVED_VERSION);
+    for (size_t i = 0; i < seg_names.size() && i < segments.size(); i++) {
+        k.add_str(seg_names[i]);
+        k.add_stamp(segments[i]->stamp);
+    }
+    return k.key();
+}
+
+uint64_t embeddings_key(const fs::path& path, const FileStamp& stamp, uint64_t segments) {
+    if (!stamp.exists) return 0;
+    KeyHasher k;
+    k.add_str("embeddings");
+    k.add_u64(DERIVED_VERSION);
+    k.add_str(path.string());
+    k.add_stamp(stamp);
+    k.add_u64(segments);
+    return k.key();
+}
+
+fs::path derived_dir(const fs::path& index_dir) {
+    return index_dir / "derived";
+}
+
+// Map a derived file whose header is intact and carries `key`
+static bool open_derived(const fs::path& path, uint64_t key, MappedFile& file, ByteSpan& payload) {
+    std::error_code ec;
+    if (key == 0 || !fs::exists(path, ec) || !file.open(path, MapAccess::Sequential)) return false;
+
+    DerivedHeader h;
+    if (file.size() < sizeof(h)) return false;
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (std::memcmp(h.magic, DERIVED_MAGIC, sizeof(DERIVED_MAGIC)) != 0 ||
+        h.version != DERIVED_VERSION || h.key != key || h.payload_size != file.size() - sizeof(h)) {
+        return false;
+    }
+    payload = file.span(sizeof(h), h.payload_size);
+    return true;
+}
+
+// Write header + body to a temp file, then rename it over `path`
+static bool write_derived(const fs::path& path, uint64_t key,
+                          const std::function<void(std::ofstream&)>& body, std::string& err) {
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        DerivedHeader h{};
+        std::memcpy(h.magic, DERIVED_MAGIC, sizeof(DERIVED_MAGIC));
+        h.version = DERIVED_VERSION;
+        h.key = key;
+        out.write((const char*)&h, sizeof(h));
+        body(out);
+
+        // Payload size is known once the body is written
+        if (out) {
+            h.payload_size = (uint64_t)out.tellp() - sizeof(h);
+            out.seekp(0);
+            out.write((const char*)&h, sizeof(h));
+        }
+        if (!out) { err = "failed to write " + tmp.string(); return false; }
+    }
+    fs::rename(tmp, path, ec);
+    if (ec) { err = "failed to replace " + path.string(); return false; }
+    return true;
+}
+
+// metadata.bin: u64 rows, then per row (string cord_uid, u64 offset, u32 length)
+bool load_derived_metadata(const fs::path& index_dir, uint64_t key,
+                           std::unordered_map<std::string, MetaInfo>& out) {
+    fs::path path = derived_dir(index_dir) / "metadata.bin";
+    MappedFile file;
+    ByteSpan payload;
+    if (!open_derived(path, key, file, payload)) return false;
+
+    ByteReader in(payload);
+    uint64_t rows = in.u64();
+    if (rows > in.remaining()) rows = 0;
+    std::unordered_map<std::string, MetaInfo> map;
+    map.reserve((size_t)rows);
+    for (uint64_t i = 0; i < rows && in.ok(); i++) {
+        std::string uid = in.str();
+        MetaInfo m;
+        m.file_offset = in.u64();
+        m.row_length = in.u32();
+        map.emplace(std::move(uid), m);
+    }
+    if (!in.ok() || in.remaining() != 0) {
+        std::cerr << "[derived] ignoring damaged " << path.string() << "\n";
+        return false;
+    }
+    out = std::move(map);
+    return true;
+}
+
+bool save_derived_metadata(const fs::path& index_dir, uint64_t key,
+                           const std::unordered_map<std::string, MetaInfo>& uid_to_meta, std::string& err) {
+    return write_derived(derived_dir(index_dir) / "metadata.bin", key, [&](std::ofstream& out) {
+        write_u64(out, uid_to_meta.size());
+        for (const auto& [uid, m] : uid_to_meta) {
+            write_string(out, uid);
+            write_u64(out, m.file_offset);
+            write_u32(out, m.row_length);
+        }
+    }, err);
+}
+
+// autocomplete.bin: AutocompleteIndex::save()
+bool load_derived_autocomplete(const fs::path& index_dir, uint64_t key,
+                               std::vector<const TermDictionary*> dicts, AutocompleteIndex& out) {
+    fs::path path = derived_dir(index_dir) / "autocomplete.bin";
+    MappedFile file;
+    ByteSpan payload;
+    if (!open_derived(path, key, file, payload)) return false;
+
+    ByteReader in(payload);
+    if (!out.load(std::move(dicts), in) || in.remaining() != 0) {
+        out.clear();
+        std::cerr << "[derived] ignoring damaged " << path.string() << "\n";
+        return false;
+    }
+    return true;
+}
+
+bool save_derived_autocomplete(const fs::path& index_dir, uint64_t key,
+                               const AutocompleteIndex& ac, std::string& err) {
+    return write_derived(derived_dir(index_dir) / "autocomplete.bin", key,
+                         [&](std::ofstream& out) { ac.save(out); }, err);
+}
+
+// embeddings.bin: u32 dim, u32 enabled, u32 rows, the row terms (strings),
+// then rows * dim floats (already normalized)
+bool load_derived_embeddings(const fs::path& index_dir, uint64_t key, SemanticIndex& out) {
+    fs::path path = derived_dir(index_dir) / "embeddings.bin";
+    MappedFile file;
+    ByteSpan payload;
+    if (!open_derived(path, key, file, payload)) return false;
+
+    ByteReader in(payload);
+    SemanticIndex sem;
+    sem.dim = (int)in.u32();
+    sem.enabled = in.u32() != 0;
+    uint32_t rows = in.u32();
+    if (rows > in.remaining()) rows = 0;
+    sem.terms.reserve(rows);
+    sem.term_to_row.reserve(rows);
+    for (uint32_t r = 0; r < rows && in.ok(); r++) {
+        sem.terms.push_back(in.str());
+        sem.term_to_row.emplace(sem.terms.back(), r);
+    }
+
+    // Vectors are copied out of the mapping in one block
+    uint64_t floats = (uint64_t)rows * (uint64_t)(sem.dim > 0 ? sem.dim : 0);
+    ByteSpan vecs = in.ok() && floats <= in.remaining() / sizeof(float)
+                        ? in.bytes((size_t)floats * sizeof(float)) : ByteSpan{};
+    if (!in.ok() || sem.terms.size() != rows || (floats && vecs.empty()) || in.remaining() != 0) {
+        std::cerr << "[derived] ignoring damaged " << path.string() << "\n";
+        return false;
+    }
+    sem.vecs.resize((size_t)floats);
+    if (floats) std::memcpy(sem.vecs.data(), vecs.data, vecs.size);
+    out = std::move(sem);
+    return true;
+}
+
+bool save_derived_embeddings(const fs::path& index_dir, uint64_t key,
+                             const SemanticIndex& sem, std::string& err) {
+    return write_derived(derived_dir(index_dir) / "embeddings.bin", key, [&](std::ofstream& out) {
+        write_u32(out, (uint32_t)(sem.dim > 0 ? sem.dim : 0));
+        write_u32(out, sem.enabled ? 1 : 0);
+        write_u32(out, (uint32_t)sem.terms.size());
+        for (const auto& t : sem.terms) write_string(out, t);
+        out.write((const char*)sem.vecs.data(), (std::streamsize)(sem.vecs.size() * sizeof(float)));
+    }, err);
+}
+
+} // namespace cord19
@@ -0,0 +1,143 @@
+#include "api_dictionary.hpp"
+
+#include <cstring>
+
+namespace cord19 {
+
+bool TermDictionary::open(ByteSpan bytes, std::string& err) {
+    block_offsets_ = nullptr;
+    data_ = nullptr;
+    if (bytes.size < sizeof(DictHeader)) { err = "lexicon.dict too short"; return false; }
+    std::memcpy(&h_, bytes.data, sizeof(h_));
+    if (std::memcmp(h_.magic, DICT_MAGIC, sizeof(DICT_MAGIC)) != 0) { err = "lexicon.dict: bad magic"; return false; }
+    if (h_.version != DICT_VERSION) { err = "lexicon.dict: unsupported version " + std::to_string(h_.version); return false; }
+    if (h_.block_size == 0 ||
+        h_.block_count != ((uint64_t)h_.term_count + h_.block_size - 1) / h_.block_size) {
+        err = "lexicon.dict: bad counts";
+        return false;
+    }
+
+    uint64_t index_size = ((uint64_t)h_.block_count + 1) * sizeof(uint32_t);
+    ByteSpan index = bytes.sub(sizeof(DictHeader), index_size);
+    ByteSpan data = bytes.sub(sizeof(DictHeader) + index_size, h_.data_size);
+    if (index.empty() || (h_.data_size && data.empty())) { err = "lexicon.dict: table out of range"; return false; }
+    if ((uintptr_t)index.data % alignof(uint32_t) != 0) { err = "lexicon.dict: misaligned index"; return false; }
+
+    // Block offsets must rise through the data area; blocks are decoded unchecked against it
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(index.data);
+    for (uint32_t b = 0; b < h_.block_count; b++) {
+        if (offsets[b] > offsets[b + 1]) { err = "lexicon.dict: bad block index"; return false; }
+    }
+    if (offsets[h_.block_count] != h_.data_size) { err = "lexicon.dict: bad block index"; return false; }
+
+    block_offsets_ = offsets;
+    data_ = data.data;
+    return true;
+}
+
+bool TermDictionary::adopt(std::vector<uint8_t> bytes, std::string& err) {
+    owned_ = std::move(bytes);
+    if (open(ByteSpan{owned_.data(), owned_.size()}, err)) return true;
+    owned_.clear();
+    return false;
+}
+
+// First term of block b, read in place (it is stored whole)
+bool TermDictionary::block_first(uint32_t b, std::string_view& out) const {
+    const uint8_t* p = data_ + block_offsets_[b];
+    const uint8_t* end = data_ + block_offsets_[b + 1];
+    uint32_t shared = 0, len = 0;
+    if (!dict_get_varint(p, end, shared) || !dict_get_varint(p, end, len)) return false;
+    if (shared != 0 || len > (size_t)(end - p)) return false;
+    out = std::string_view((const char*)p, len);
+    return true;
+}
+
+TermDictionary::Cursor TermDictionary::begin() const {
+    Cursor c;
+    c.dict_ = this;
+    if (h_.term_count > 0 && data_) c.seek_block(0);
+    return c;
+}
+
+TermDictionary::Cursor TermDictionary::lower_bound(std::string_view key) const {
+    Cursor c;
+    c.dict_ = this;
+    if (h_.term_count == 0 || !data_) return c;
+
+    // Last block whose first term is <= key (block 0 if none)
+    uint32_t lo = 0, hi = h_.block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        std::string_view first;
+        if (!block_first(mid, first)) return c;
+        if (first <= key) lo = mid + 1;
+        else hi = mid;
+    }
+
+    // At most one block of terms (plus the next block's first) lies before the answer
+    c.seek_block(lo == 0 ? 0 : lo - 1);
+    while (c.valid() && c.term() < key) c.next();
+    return c;
+}
+
+void TermDictionary::Cursor::seek_block(uint32_t b) {
+    index_ = b * dict_->h_.block_size;
+    p_ = dict_->data_ + dict_->block_offsets_[b];
+    end_ = dict_->data_ + dict_->block_offsets_[b + 1];
+    term_.clear();
+    valid_ = decode();
+}
+
+// Decode the entry at p_ on top of the previous term
+bool TermDictionary::Cursor::decode() {
+    uint32_t shared = 0, len = 0;
+    if (!dict_get_varint(p_, end_, shared) || !dict_get_varint(p_, end_, len)) return false;
+    if (shared > term_.size() || len > (size_t)(end_ - p_)) return false;
+    term_.resize(shared);
+    term_.append((const char*)p_, len);
+    p_ += len;
+    return dict_get_varint(p_, end_, term_id_) && dict_get_varint(p_, end_, df_);
+}
+
+void TermDictionary::Cursor::next() {
+    if (!valid_) return;
+    index_++;
+    if (index_ >= dict_->h_.term_count) valid_ = false;
+    else if (index_ % dict_->h_.block_size == 0) seek_block(index_ / dict_->h_.block_size);
+    else valid_ = decode();
+}
+
+// k-way merge of the per-dictionary ranges (a linear scan for the smallest
+// term: there are only a few segments)
+void scan_prefix(const std::vector<const TermDictionary*>& dicts, std::string_view prefix,
+                 const std::function<bool(std::string_view, uint64_t)>& f) {
+    std::vector<TermDictionary::Cursor> cursors;
+    cursors.reserve(dicts.size());
+    for (const TermDictionary* d : dicts) cursors.push_back(d->lower_bound(prefix));
+
+    auto in_range = [&](const TermDictionary::Cursor& c) {
+        return c.valid() && c.term().substr(0, prefix.size()) == prefix;
+    };
+
+    std::string term;
+    while (true) {
+        const TermDictionary::Cursor* min = nullptr;
+        for (const auto& c : cursors) {
+            if (in_range(c) && (!min || c.term() < min->term())) min = &c;
+        }
+        if (!min) return;
+
+        term = min->term();
+        uint64_t df = 0;
+        for (auto& c : cursors) {
+            if (in_range(c) && c.term() == term) {
+                df += c.df();
+                c.next();
+            }
+        }
+        if (!f(term, df)) return;
+    }
+}
+
+} // namespace cord19
@@ -1,11 +1,14 @@
 #include "api_engine.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <cstdlib>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 #include <queue>
+#include <sstream>
 #include <unordered_set>
 
 // Include metadata, segment, IO, and text utilities
@@ -15,7 +18,21 @@ using namespace cord19;
 
 // Destructor: save all caches before engine is destroyed
 Engine::~Engine() {
-    std::lock_guard<std::mutex> lock(mtx);
+    // Let a background reload finish first
+    if (reload_thread_.joinable()) reload_thread_.join();
+
+    // Write out documents still buffered in memory (a buffer whose earlier
+    // write failed goes first, then the one filled meanwhile)
+    stop_ram_flusher();
+    std::string err;
+    for (int i = 0; i < 2 && ram_doc_count() > 0; i++) {
+        if (!flush_ram(err)) {
+            std::cerr << "[flush] " << err << "\n";
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(cache_mtx);
     
     // Save search cache if there are unsaved updates
     if (cache_updates_since_save > 0 || !cache.empty()) {
@@ -35,92 +52,620 @@ Engine::~Engine() {
         save_ai_summary_cache();
     }
 }
+#include "api_postings.hpp"
+#include "api_query.hpp"
 #include "api_segment.hpp"
 #include "indexio.hpp"
-#include "textutil.hpp"
 
 namespace cord19 {
 
 // Compute BM25 IDF value from total docs and document frequency
-static float bm25_idf(uint32_t N, uint32_t df) {
+// (df is clamped to N so the unsigned N - df cannot wrap)
+static float bm25_idf(uint64_t N, uint64_t df) {
+    df = std::min(df, N);
     return std::log((((N - df + 0.5f) / (df + 0.5f)) + 1.0f));
 }
 
-// Reload index segments, autocomplete, metadata, and optional embeddings
+// True when `path` only grew past `old` by appended rows (its old last byte
+// is still a newline), so rows before old.size need not be parsed again
+static bool appended_since(const fs::path& path, const FileStamp& old, const FileStamp& now) {
+    if (!old.exists || old.size == 0 || now.size <= old.size) return false;
+    std::ifstream in(path, std::ios::binary);
+    char c = 0;
+    return in.seekg((std::streamoff)old.size - 1) && in.get(c) && c == '\n';
+}
+
+// Reload index segments, autocomplete, metadata, and optional embeddings.
+// The new state is built in a private snapshot and published with one atomic
+// swap, so searches keep running against the old snapshot meanwhile.
 bool Engine::reload() {
-    std::cerr << "[reload] metadata map size: " << uid_to_meta.size() << "\n";
+    // Only one reload at a time; readers are never blocked by this lock
+    std::lock_guard<std::mutex> reload_lock(reload_mtx);
+    auto t0 = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(status_mtx);
+        status_.running = true;
+        status_.phase = "manifest";
+        status_.segments_total = 0;
+        status_.segments_done = 0;
+        status_.started_at_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
 
-    // Lock engine during reload to avoid concurrent reads/writes
-    std::lock_guard<std::mutex> lock(mtx);
+    std::string err;
+    bool ok = build_snapshot(err);
 
-    // Load segment names from manifest file
-    seg_names = load_manifest(index_dir / "manifest.bin");
-    if (seg_names.empty()) {
-        // Fallback: scan segments directory if manifest is missing/empty
-        fs::path segroot = index_dir / "segments";
-        if (fs::exists(segroot) && fs::is_directory(segroot)) {
-            seg_names.clear();
-            for (auto& e : fs::directory_iterator(segroot)) {
-                if (!e.is_directory()) continue;
-                auto name = e.path().filename().string();
-                if (name.rfind("seg_", 0) == 0) seg_names.push_back(name);
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    {
+        std::lock_guard<std::mutex> lock(status_mtx);
+        status_.running = false;
+        status_.phase = "idle";
+        status_.last_duration_ms = ms;
+        status_.last_ok = ok;
+        status_.last_error = ok ? "" : err;
+        status_.reloads++;
+        if (!ok) status_.failures++;
+    }
+    if (!ok) {
+        std::cerr << "[reload] failed after " << ms << " ms, still serving generation "
+                  << snapshot()->generation << ": " << err << "\n";
+        return false;
+    }
+
+    // Load the caches saved by an earlier run; later reloads keep the
+    // in-memory ones (disk copies may predate this process's updates)
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        if (!caches_loaded) {
+            load_cache();
+            load_ai_overview_cache();
+            load_ai_summary_cache();
+            caches_loaded = true;
+        }
+    }
+
+    // Reload successful
+    return true;
+}
+
+// Start reload() on the background thread, or queue one behind it
+bool Engine::reload_async() {
+    std::lock_guard<std::mutex> lock(status_mtx);
+    if (async_running_) {
+        status_.queued = true;
+        return false;
+    }
+
+    // The previous thread cleared async_running_ as its last step
+    if (reload_thread_.joinable()) reload_thread_.join();
+    async_running_ = true;
+    reload_thread_ = std::thread([this] {
+        while (true) {
+            reload();
+            std::lock_guard<std::mutex> lock(status_mtx);
+            if (!status_.queued) {
+                async_running_ = false;
+                return;
             }
-            std::sort(seg_names.begin(), seg_names.end());
+            status_.queued = false;
         }
+    });
+    return true;
+}
+
+ReloadStatus Engine::reload_status() const {
+    std::lock_guard<std::mutex> lock(status_mtx);
+    return status_;
+}
+
+// Find the docs in the loaded segments and the RAM buffers, rewrite the
+// affected live.bin files and reload (which rereads just those files)
+bool Engine::delete_documents(const std::vector<std::string>& cord_uids, size_t& deleted, std::string& err) {
+    std::lock_guard<std::mutex> delete_lock(delete_mtx);
+    deleted = 0;
+    std::unordered_set<std::string_view> wanted(cord_uids.begin(), cord_uids.end());
+    if (wanted.empty()) return true;
+
+    std::optional<ManifestLock> manifest_lock;
+    if (!delete_on_disk(wanted, deleted, err, manifest_lock)) return false;
+    const size_t on_disk = deleted;
+    {
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        size_t in_ram = delete_in_ram(wanted);
+        deleted += in_ram;
+        if (in_ram && !on_disk) republish();
     }
+    manifest_lock.reset();
+    if (deleted == 0) return true;
 
-    // Stop if no segments were found
-    if (seg_names.empty()) return false;
+    std::cerr << "[delete] " << deleted << " docs deleted for " << wanted.size() << " cord_uids\n";
+    if (on_disk && !reload()) {
+        err = "deleted, but reload failed: " + reload_status().last_error;
+        return false;
+    }
 
-    // Load all segments into memory
-    std::vector<Segment> loaded;
-    loaded.reserve(seg_names.size());
+    // Cached result lists may still name the deleted docs
+    forget_cached({}, wanted);
+    return true;
+}
+
+// Clear the live bits of `wanted` in the disk segments' live.bin files
+// (delete_mtx held); `deleted` counts the docs newly deleted.
+//
+// The files are written under ManifestLock, after checking that the
+// manifest still lists every segment of the snapshot: a merge swaps its
+// sources out under the same lock, so a delete either lands before the swap
+// (and the merge sees it and backs off) or finds a replaced segment, loads
+// the merged one and tries again. On success `lock` is left held for
+// delete_in_ram(), whose flushed buffer's segment was checked the same way.
+bool Engine::delete_on_disk(const std::unordered_set<std::string_view>& wanted, size_t& deleted,
+                            std::string& err, std::optional<ManifestLock>& lock) {
+    for (int attempt = 0; attempt < 3; attempt++) {
+        lock.reset();
+        if (attempt > 0 && !reload()) {
+            err = "segments were replaced and reload failed: " + reload_status().last_error;
+            return false;
+        }
+        auto snap = snapshot();
 
-    for (auto& name : seg_names) {
-        Segment s;
-        fs::path segdir = index_dir / "segments" / name;
-        if (!load_segment(segdir, s)) {
-            std::cerr << "Failed to load segment: " << segdir << "\n";
+        lock.emplace(index_dir);
+        if (!lock->ok()) {
+            err = "cannot lock " + index_lock_path(index_dir).string();
             return false;
         }
-        loaded.push_back(std::move(s));
+        std::vector<std::string> current = list_segments(index_dir);
+        std::unordered_set<std::string_view> listed(current.begin(), current.end());
+        bool replaced = false;
+        for (size_t i = 0; i < snap->disk_count && !replaced; i++) replaced = !listed.count(snap->seg_names[i]);
+        {
+            std::lock_guard<std::mutex> ram_lock(ram_mtx);
+            if (flushing_ && flushing_epoch_) replaced = replaced || !listed.count(flushing_dir_.filename().string());
+        }
+        if (replaced) continue;
+
+        for (size_t i = 0; i < snap->disk_count; i++) {
+            const Segment& seg = *snap->segments[i];
+
+            // live.bin on disk, not the snapshot's copy: it may be newer
+            LiveDocs live;
+            bool loaded = false;
+            size_t removed = 0;
+            for (std::string_view uid : wanted) {
+                auto [first, last] = find_uid(seg, uid);
+                for (const uint32_t* d = first; d != last; ++d) {
+                    if (!loaded && !read_live_docs(seg.dir, seg.doc_count(), live, err)) {
+                        err = snap->seg_names[i] + ": " + err;
+                        return false;
+                    }
+                    loaded = true;
+                    if (live.remove(*d)) removed++;
+                }
+            }
+            if (removed == 0) continue;
+            if (!write_live_docs(seg.dir, live, err)) return false;
+            deleted += removed;
+        }
+        return true;
     }
+    err = "segments keep being replaced, delete not applied";
+    return false;
+}
 
-    // Replace engine segments with newly loaded segments
-    segments = std::move(loaded);
+// Flag the copies of `wanted` in the RAM buffers (delete_mtx, the
+// ManifestLock from delete_on_disk() and ram_mtx held). A buffer already
+// committed to the manifest but not yet reloaded gets its segment's live.bin
+// rewritten as well.
+size_t Engine::delete_in_ram(const std::unordered_set<std::string_view>& wanted) {
+    size_t removed = 0, flushed = 0;
+    for (std::string_view uid : wanted) {
+        removed += ram_.remove(uid);
+        if (flushing_) flushed += flushing_->remove(uid);
+    }
+    if (flushed && flushing_epoch_) {
+        std::string err;
+        if (!write_live_docs(flushing_dir_, *flushing_->live_docs(), err)) std::cerr << "[delete] " << err << "\n";
+    }
+    return removed + flushed;
+}
+
+// Buffer the document in memory and publish a snapshot that searches it.
+// Older copies on disk are deleted first, so the reload that drops them
+// publishes the new copy at the same time.
+bool Engine::add_document(RamDoc doc, size_t& replaced, std::string& err) {
+    replaced = 0;
+    if (doc.meta.cord_uid.empty()) {
+        err = "cord_uid is required";
+        return false;
+    }
+    if (doc.meta.doc_len == 0) {
+        err = "document has no indexable text";
+        return false;
+    }
 
-    // Build autocomplete index using df scores from all segment lexicons
+    std::lock_guard<std::mutex> delete_lock(delete_mtx);
+    const std::string uid = doc.meta.cord_uid;
+    std::unordered_set<std::string_view> wanted{uid};
+    std::unordered_set<std::string> terms;
+    for (const auto& t : doc.terms) terms.insert(t.first);
+    std::optional<ManifestLock> manifest_lock;
+    if (!delete_on_disk(wanted, replaced, err, manifest_lock)) return false;
+    const size_t on_disk = replaced;
     {
-        std::unordered_map<std::string, uint32_t> term_to_score;
-        term_to_score.reserve(200000);
-
-        // Sum df across segments for each term
-        for (const auto& seg : segments) {
-            for (const auto& kv : seg.lex) {
-                const std::string& term = kv.first;
-                const LexEntry& e = kv.second;
-                term_to_score[term] += e.df;
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        replaced += delete_in_ram(wanted);
+        ram_.add(std::move(doc));
+        if (!on_disk) republish();
+    }
+    manifest_lock.reset();
+    if (on_disk && !reload()) {
+        // Serve the new copy anyway; the old one goes with the next reload
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        republish();
+        err = "added, but reload failed: " + reload_status().last_error;
+        return false;
+    }
+
+    // Cached result lists of queries on its terms predate the document
+    forget_cached(terms, wanted);
+    return true;
+}
+
+// Write the buffer as a segment while searches keep using it in memory, then
+// commit it to the manifest. The snapshot that first reads the new manifest
+// swaps the buffer for the segment, so its docs are never served twice.
+bool Engine::flush_ram(std::string& err) {
+    std::lock_guard<std::mutex> flush_lock(flush_mtx);
+    auto t0 = std::chrono::steady_clock::now();
+
+    // A flush committed earlier whose reload failed: finish it first
+    bool pending;
+    {
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        pending = flushing_ && flushing_epoch_;
+    }
+    if (pending && !reload()) {
+        err = "the previous flush is not loaded yet: " + reload_status().last_error;
+        return false;
+    }
+
+    // Take the buffer (or retry one whose write failed)
+    const RamBuffer* buf = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        if (!flushing_) {
+            if (ram_.empty()) return true;
+            flushing_ = std::make_unique<RamBuffer>(std::move(ram_));
+            ram_ = RamBuffer();
+        }
+        buf = flushing_.get();
+    }
+    const size_t docs = buf->doc_count();
+
+    // Claim a segment name; the folder stays out of the manifest until committed
+    std::string name;
+    fs::path segdir;
+    std::error_code ec;
+    {
+        ManifestLock lock(index_dir);
+        if (!lock.ok()) {
+            err = "cannot lock " + index_lock_path(index_dir).string();
+            return false;
+        }
+        name = next_segment_name(index_dir);
+        segdir = index_dir / "segments" / name;
+        fs::create_directories(segdir, ec);
+    }
+
+    // Every buffered doc is written (deleted ones too), so docIds match the
+    // buffer's and live.bin can mark the deleted ones
+    SegmentWriter writer;
+    buf->fill_writer(writer);
+    if (!writer.write_segment(segdir, err)) {
+        err = name + ": " + err;
+        fs::remove_all(segdir, ec);
+        return false;
+    }
+
+    // No deletes from here until the reload has swapped the buffer out
+    std::lock_guard<std::mutex> delete_lock(delete_mtx);
+    std::shared_ptr<const LiveDocs> live;
+    {
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        live = buf->live_docs();
+    }
+    if (live && !write_live_docs(segdir, *live, err)) {
+        fs::remove_all(segdir, ec);
+        return false;
+    }
+    {
+        ManifestLock lock(index_dir);
+        if (!lock.ok()) {
+            err = "cannot lock " + index_lock_path(index_dir).string();
+            fs::remove_all(segdir, ec);
+            return false;
+        }
+        std::vector<std::string> names = list_segments(index_dir);
+        if (std::find(names.begin(), names.end(), name) == names.end()) names.push_back(name);
+        if (!save_manifest(index_dir / "manifest.bin", names)) {
+            err = "failed to write manifest.bin";
+            fs::remove_all(segdir, ec);
+            return false;
+        }
+        std::lock_guard<std::mutex> ram_lock(ram_mtx);
+        flushing_epoch_ = ++ram_flushes_;
+        flushing_dir_ = segdir;
+    }
+
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "[flush] " << docs << " docs -> " << name << " in " << ms << " ms\n";
+    if (!reload()) {
+        err = "flushed to " + name + ", but reload failed: " + reload_status().last_error;
+        return false;
+    }
+
+    // Cached result lists belong to the snapshot that still had the buffer
+    clear_search_cache();
+    return true;
+}
+
+void Engine::start_ram_flusher(std::chrono::seconds interval) {
+    stop_ram_flusher();
+    flusher_stop_ = false;
+    flusher_ = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lock(flusher_mtx);
+        while (!flusher_cv.wait_for(lock, interval, [this] { return flusher_stop_; })) {
+            bool due;
+            {
+                std::lock_guard<std::mutex> ram_lock(ram_mtx);
+                due = ram_.flush_due(ram_policy) || (flushing_ && !flushing_epoch_);
             }
+            if (!due) continue;
+            lock.unlock();
+            std::string err;
+            if (!flush_ram(err)) std::cerr << "[flush] " << err << "\n";
+            lock.lock();
         }
+    });
+}
 
-        // Build autocomplete trie with top 10 candidates per prefix
-        ac.build(term_to_score, 10);
+void Engine::stop_ram_flusher() {
+    {
+        std::lock_guard<std::mutex> lock(flusher_mtx);
+        flusher_stop_ = true;
     }
+    flusher_cv.notify_all();
+    if (flusher_.joinable()) flusher_.join();
+}
 
-    // Reload metadata mapping from CSV
-    uid_to_meta.clear();
-    metadata_csv_path = index_dir / "metadata.csv";
-    load_metadata_uid_meta(metadata_csv_path, uid_to_meta);
+size_t Engine::ram_doc_count() {
+    std::lock_guard<std::mutex> lock(ram_mtx);
+    return ram_.doc_count() + (flushing_ ? flushing_->doc_count() : 0);
+}
 
-    // Reset semantic index and load embeddings if available
-    sem = SemanticIndex();
+void Engine::set_reload_phase(const char* phase, size_t segments_done) {
+    std::lock_guard<std::mutex> lock(status_mtx);
+    status_.phase = phase;
+    status_.segments_done = segments_done;
+}
+
+// Build and publish the next snapshot (reload_mtx held). Nothing is published
+// unless every segment loads and checks out.
+//
+// Reload is incremental: manifest.bin is diffed against the current snapshot,
+// segments whose files are unchanged are shared with it and only added or
+// rewritten ones are opened. Derived state is reused or extended the same way.
+bool Engine::build_snapshot(std::string& err) {
+    auto t0 = std::chrono::steady_clock::now();
+    auto prev = snapshot();
+    auto next = std::make_shared<IndexSnapshot>();
+
+    // Wall time of each phase, logged with the summary line
+    std::ostringstream phase_ms;
+    auto lap = t0;
+    auto end_phase = [&](const char* phase) {
+        auto now = std::chrono::steady_clock::now();
+        phase_ms << " " << phase << "="
+                 << std::chrono::duration_cast<std::chrono::milliseconds>(now - lap).count();
+        lap = now;
+    };
+
+    // Load segment names from manifest file (or the segments directory)
+    auto& seg_names = next->seg_names;
     {
-        // Collect only needed terms to reduce embedding memory usage
-        std::unordered_set<std::string> needed_terms;
-        needed_terms.reserve(250000);
-        for (const auto& seg : segments) {
-            for (const auto& kv : seg.lex) needed_terms.insert(kv.first);
+        std::lock_guard<std::mutex> lock(manifest_mutex());
+        seg_names = list_segments(index_dir);
+        next->ram_flushes = ram_flushes_;
+    }
+
+    // Stop if no segments were found
+    if (seg_names.empty()) {
+        err = "no segments in " + (index_dir / "segments").string();
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(status_mtx);
+        status_.segments_total = seg_names.size();
+    }
+
+    end_phase("manifest");
+
+    // Take over unchanged segments from the current snapshot. The rest are
+    // opened on load_pool, each into its manifest slot.
+    std::unordered_map<std::string, size_t> prev_at;
+    for (size_t i = 0; i < prev->disk_count; i++) prev_at[prev->seg_names[i]] = i;
+
+    next->segments.resize(seg_names.size());
+    std::vector<bool> opened(seg_names.size(), false);
+    std::vector<size_t> to_open;
+    size_t kept = 0;
+
+    for (size_t i = 0; i < seg_names.size(); i++) {
+        auto it = prev_at.find(seg_names[i]);
+        if (it != prev_at.end() &&
+            prev->segments[it->second]->stamp == segment_stamp(index_dir / "segments" / seg_names[i])) {
+            next->segments[i] = prev->segments[it->second];
+            kept++;
+            continue;
+        }
+        to_open.push_back(i);
+        opened[i] = true;
+    }
+
+    set_reload_phase("segments", kept);
+    std::vector<std::string> load_errors(to_open.size());
+    std::atomic<size_t> loaded{kept};
+    parallel_for(load_pool.get(), to_open.size(), [&](size_t j) {
+        const std::string& name = seg_names[to_open[j]];
+        auto s = std::make_shared<Segment>();
+        if (!load_segment(index_dir / "segments" / name, *s, load_pool.get())) {
+            load_errors[j] = "failed to load segment " + name;
+        } else if (s->N != s->doc_count() || s->uid_offsets.size() != (size_t)s->doc_count() + 1) {
+            // Doc columns must agree before queries index them by docId
+            load_errors[j] = "segment " + name + ": stats.bin and docs.bin disagree on the doc count";
+        } else {
+            next->segments[to_open[j]] = std::move(s);
+        }
+        set_reload_phase("segments", ++loaded);
+    });
+    for (const auto& e : load_errors) {
+        if (!e.empty()) { err = e; return false; }
+    }
+    end_phase("segments");
+
+    // Postings, positions and forward sections are checksummed before the
+    // segments are published; kept segments were verified when first opened
+    set_reload_phase("verify", kept);
+    loaded = kept;
+    parallel_for(load_pool.get(), to_open.size(), [&](size_t j) {
+        const std::string& name = seg_names[to_open[j]];
+        std::string e;
+        if (!next->segments[to_open[j]]->store.verify_bulk(e, load_pool.get())) {
+            std::cerr << "[segment] rejected " << name << ": " << e << "\n";
+            load_errors[j] = "segment " + name + ": " + e;
+        }
+        set_reload_phase("verify", ++loaded);
+    });
+    for (const auto& e : load_errors) {
+        if (!e.empty()) { err = e; return false; }
+    }
+    end_phase("verify");
+    const size_t dropped = prev->disk_count - kept;
+
+    // Build corpus-wide stats (queries scale doc lengths by stats.avgdl)
+    auto& stats = next->stats;
+    for (const auto& seg : next->segments) add_segment_stats(stats, *seg);
+
+    // Position of each kept segment in the current snapshot
+    std::unordered_map<const Segment*, size_t> prev_index;
+    for (size_t i = 0; i < prev->segments.size(); i++) prev_index[prev->segments[i].get()] = i;
+
+    // Deletion bitmaps: only live.bin files that changed are read again
+    set_reload_phase("deletes", seg_names.size());
+    next->live.reserve(next->segments.size());
+    next->live_stamps.reserve(next->segments.size());
+    for (size_t i = 0; i < next->segments.size(); i++) {
+        const Segment& seg = *next->segments[i];
+        FileStamp stamp = file_stamp(live_docs_path(seg.dir));
+        next->live_stamps.push_back(stamp);
+
+        // A stamp can miss a rewrite within one mtime tick; the header's
+        // deleted count cannot
+        auto it = prev_index.find(&seg);
+        if (it != prev_index.end() && prev->live_stamps[it->second] == stamp) {
+            const auto& prev_live = prev->live[it->second];
+            if (read_live_deleted_count(seg.dir) == (prev_live ? prev_live->deleted : 0)) {
+                next->live.push_back(prev_live);
+                continue;
+            }
+        }
+
+        auto live = std::make_shared<LiveDocs>();
+        if (!read_live_docs(seg.dir, seg.doc_count(), *live, err)) {
+            err = seg_names[i] + ": " + err;
+            return false;
+        }
+        if (live->deleted == 0) live.reset();
+        next->live.push_back(std::move(live));
+    }
+
+    end_phase("deletes");
+
+    // Autocomplete reads the segments' sorted dictionaries, top 10 per prefix.
+    // With segments only added, the current lists are extended by their terms;
+    // otherwise they come from derived/ when saved for these segments.
+    set_reload_phase("autocomplete", seg_names.size());
+    auto& keys = next->derived;
+    keys.autocomplete = segments_key(seg_names, next->segments);
+    std::vector<const TermDictionary*> dicts, added;
+    for (size_t i = 0; i < next->segments.size(); i++) {
+        dicts.push_back(&next->segments[i]->dict);
+        if (opened[i]) added.push_back(&next->segments[i]->dict);
+    }
+    if (dropped == 0 && added.empty() && !prev->ac->empty()) {
+        next->ac = prev->ac;
+    } else if (dropped == 0 && !prev->ac->empty()) {
+        auto ac = std::make_shared<AutocompleteIndex>(*prev->ac);
+        ac->add_dictionaries(std::move(dicts), added);
+        next->ac = std::move(ac);
+    } else {
+        auto ac = std::make_shared<AutocompleteIndex>();
+        if (load_derived_autocomplete(index_dir, keys.autocomplete, dicts, *ac)) {
+            derived_saved_.autocomplete = keys.autocomplete;
+        } else {
+            ac->build(std::move(dicts), 10);
+        }
+        next->ac = std::move(ac);
+    }
+
+    end_phase("autocomplete");
+
+    // Load metadata mapping from CSV: reuse it while the file is unchanged,
+    // take it from derived/ if saved for this file, else parse only the new
+    // rows when it was appended to
+    set_reload_phase("metadata", seg_names.size());
+    fs::path metadata_csv = index_dir / "metadata.csv";
+    next->metadata_stamp = file_stamp(metadata_csv);
+    keys.metadata = metadata_key(next->metadata_stamp);
+    if (next->metadata_stamp.exists && next->metadata_stamp == prev->metadata_stamp) {
+        next->uid_to_meta = prev->uid_to_meta;
+        next->metadata = prev->metadata;
+    } else {
+        auto uid_to_meta = std::make_shared<std::unordered_map<std::string, MetaInfo>>();
+        if (load_derived_metadata(index_dir, keys.metadata, *uid_to_meta)) {
+            derived_saved_.metadata = keys.metadata;
+        } else {
+            uint64_t from = 0;
+            if (appended_since(metadata_csv, prev->metadata_stamp, next->metadata_stamp)) {
+                *uid_to_meta = *prev->uid_to_meta;
+                from = prev->metadata_stamp.size;
+            }
+            load_metadata_uid_meta(metadata_csv, *uid_to_meta, from);
         }
+        next->uid_to_meta = std::move(uid_to_meta);
+
+        auto metadata = std::make_shared<MetadataStore>();
+        metadata->open(metadata_csv);
+        next->metadata = std::move(metadata);
+    }
+
+    end_phase("metadata");
+
+    // Load embeddings if available
+    set_reload_phase("embeddings", seg_names.size());
+    {
+        // Keep only vectors of indexed terms to reduce embedding memory usage
+        const auto& segments = next->segments;
+        auto indexed = [&segments](const std::string& word) {
+            const uint64_t h = bloom_term_hash(word);
+            for (const auto& seg : segments) {
+                if (!seg->filter.may_contain(h)) continue;
+                const LexEntry* e = seg->lex.find(word);
+                if (e && e->df > 0) return true;
+            }
+            return false;
+        };
 
         // Decide embedding file path from env var or common filenames
         fs::path emb_path;
@@ -137,35 +682,168 @@ bool Engine::reload() {
                 if (fs::exists(c)) { emb_path = c; break; }
             }
         }
-
-        // Load embeddings from file if it exists
-        if (!emb_path.empty() && fs::exists(emb_path)) {
-            bool ok = sem.load_from_text(emb_path, needed_terms);
+        next->sem_path = emb_path;
+        next->sem_stamp = file_stamp(emb_path);
+
+        if (next->sem_stamp.exists && emb_path == prev->sem_path &&
+            next->sem_stamp == prev->sem_stamp) {
+            // Same file as before: keep its vectors (terms first seen in
+            // segments added since get theirs at the next server start)
+            next->sem = prev->sem;
+            keys.embeddings = prev->derived.embeddings;
+        } else if (next->sem_stamp.exists) {
+            // Vectors filtered for these segments are read back from derived/
+            keys.embeddings = embeddings_key(emb_path, next->sem_stamp, keys.autocomplete);
+            auto sem = std::make_shared<SemanticIndex>();
+            bool saved = load_derived_embeddings(index_dir, keys.embeddings, *sem);
+            if (saved) derived_saved_.embeddings = keys.embeddings;
+
+            // Load embeddings from file
+            bool ok = saved ? sem->enabled : sem->load_from_text(emb_path, indexed);
             if (ok) {
                 std::cerr << "[reload] semantic embeddings loaded: "
-                          << sem.terms.size() << " terms, dim=" << sem.dim
-                          << " from " << emb_path.string() << "\n";
+                          << sem->terms.size() << " terms, dim=" << sem->dim
+                          << " from " << (saved ? derived_dir(index_dir) / "embeddings.bin" : emb_path).string() << "\n";
             } else {
                 std::cerr << "[reload] embeddings file found but no usable vectors loaded: "
                           << emb_path.string() << " (semantic search disabled)\n";
             }
+            next->sem = std::move(sem);
         }
     }
 
-    // Load all caches from disk
-    load_cache();
-    load_ai_overview_cache();
-    load_ai_summary_cache();
+    end_phase("embeddings");
 
-    // Reload successful
+    // Publish the new snapshot with the RAM segments; the old one is freed
+    // when its last reader ends. Cursors and cached results outlive a reload
+    // that only reread live.bin files (their deletes are handled by the caller).
+    const bool same_generation =
+        next->metadata == prev->metadata && next->sem_path == prev->sem_path &&
+        next->sem_stamp == prev->sem_stamp &&
+        std::equal(next->segments.begin(), next->segments.end(),
+                   prev->segments.begin(), prev->segments.begin() + prev->disk_count);
+    {
+        std::lock_guard<std::mutex> lock(ram_mtx);
+        next->generation = same_generation ? prev->generation : ++last_generation;
+        publish(next);
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "[reload] generation " << next->generation << ": "
+              << next->disk_count << " segments (" << (next->disk_count - kept)
+              << " opened, " << dropped << " dropped), "
+              << next->uid_to_meta->size() << " metadata rows, " << ms << " ms (ms per phase:"
+              << phase_ms.str() << ")\n";
+    save_derived(*next);
     return true;
 }
 
+// Append the in-memory segments to a snapshot of the disk segments and
+// publish it (ram_mtx held)
+void Engine::publish(std::shared_ptr<IndexSnapshot> next) {
+    auto prev = snapshot();
+
+    // A flushed buffer is dropped by the first snapshot holding its segment
+    if (flushing_ && flushing_epoch_ && next->ram_flushes >= flushing_epoch_) {
+        flushing_.reset();
+        flushing_epoch_ = 0;
+        flushing_dir_.clear();
+    }
+
+    // RAM docs are normalized against the disk segments' avgdl, so adding
+    // one does not move the scores of every disk doc
+    next->disk_count = next->segments.size();
+    auto& stats = next->stats;
+
+    for (const RamBuffer* buf : {flushing_.get(), &ram_}) {
+        if (!buf) continue;
+        for (const auto& run : buf->runs()) {
+            const Segment& seg = *run.seg;
+            next->seg_names.push_back("ram");
+            next->segments.push_back(run.seg);
+            stats.N += seg.doc_count();
+            stats.total_len += seg.total_len;
+            next->live.push_back(buf->run_live(run));
+            next->live_stamps.emplace_back();
+        }
+    }
+
+    next->ram_epoch = ++last_ram_epoch;
+    std::atomic_store(&snap_, std::shared_ptr<const IndexSnapshot>(std::move(next)));
+}
+
+// Publish the current disk segments with the RAM buffers as they are now
+// (ram_mtx held)
+void Engine::republish() {
+    auto cur = snapshot();
+    auto next = std::make_shared<IndexSnapshot>(*cur);
+    const size_t n = cur->disk_count;
+    for (size_t i = n; i < cur->segments.size(); i++) {
+        next->stats.N -= cur->segments[i]->doc_count();
+        next->stats.total_len -= cur->segments[i]->total_len;
+    }
+    next->seg_names.resize(n);
+    next->segments.resize(n);
+    next->live.resize(n);
+    next->live_stamps.resize(n);
+    publish(std::move(next));
+}
+
+// Write the derived structures whose inputs changed since they were saved
+// (reload_mtx held). Failures only cost the next start a rebuild.
+void Engine::save_derived(const IndexSnapshot& snap) {
+    auto t0 = std::chrono::steady_clock::now();
+    const DerivedKeys& keys = snap.derived;
+    std::string saved, err;
+
+    if (keys.autocomplete && keys.autocomplete != derived_saved_.autocomplete) {
+        if (save_derived_autocomplete(index_dir, keys.autocomplete, *snap.ac, err)) {
+            derived_saved_.autocomplete = keys.autocomplete;
+            saved += " autocomplete";
+        } else {
+            std::cerr << "[derived] " << err << "\n";
+        }
+    }
+    if (keys.metadata && keys.metadata != derived_saved_.metadata) {
+        if (save_derived_metadata(index_dir, keys.metadata, *snap.uid_to_meta, err)) {
+            derived_saved_.metadata = keys.metadata;
+            saved += " metadata";
+        } else {
+            std::cerr << "[derived] " << err << "\n";
+        }
+    }
+    if (keys.embeddings && keys.embeddings != derived_saved_.embeddings) {
+        if (save_derived_embeddings(index_dir, keys.embeddings, *snap.sem, err)) {
+            derived_saved_.embeddings = keys.embeddings;
+            saved += " embeddings";
+        } else {
+            std::cerr << "[derived] " << err << "\n";
+        }
+    }
+
+    if (saved.empty()) return;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    std::cerr << "[derived] saved" << saved << " in " << ms << " ms\n";
+}
+
+// Resize the search worker pool (0 or 1 disables parallel scoring)
+void Engine::set_search_threads(size_t n) {
+    if (n <= 1) search_pool.reset();
+    else search_pool = std::make_unique<ThreadPool>(n);
+}
+
+// Resize the reload worker pool (0 or 1 loads segments inline)
+void Engine::set_load_threads(size_t n) {
+    if (n <= 1) load_pool.reset();
+    else load_pool = std::make_unique<ThreadPool>(n);
+}
+
 // Return autocomplete suggestions as JSON
 json Engine::suggest(const std::string& user_input, int limit) {
 
-    // Lock engine during suggest
-    std::lock_guard<std::mutex> lock(mtx);
+    // Read from the current snapshot (no engine lock needed)
+    auto snap = snapshot();
 
     // Clamp suggestion limit to 1..10
     const int L = std::max(1, std::min(limit, 10));
@@ -177,10 +855,10 @@ json Engine::suggest(const std::string& user_input, int limit) {
     out["suggestions"] = json::array();
 
     // Return empty if autocomplete index not built
-    if (ac.empty()) return out;
+    if (snap->ac->empty()) return out;
 
     // Generate suggestions and add to JSON
-    auto s = ac.suggest_query(user_input, (size_t)L);
+    auto s = snap->ac->suggest_query(user_input, (size_t)L);
     for (const auto& t : s) out["suggestions"].push_back(t);
 
     return out;
@@ -198,15 +876,54 @@ bool Engine::is_cache_entry_expired(const CacheEntry& entry) {
     return age >= CACHE_EXPIRY_DURATION;
 }
 
-// Get result from cache if available and not expired, update LRU
-json Engine::get_from_cache(const std::string& cache_key) {
+// Drop every cached search result, in memory and in search_cache.json
+void Engine::clear_search_cache() {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    if (cache.empty()) return;
+    cache.clear();
+    lru_list.clear();
+    save_cache();
+}
+
+// Results of other queries only move through the corpus N until the next
+// flush or reload starts a new generation
+void Engine::forget_cached(const std::unordered_set<std::string>& terms,
+                           const std::unordered_set<std::string_view>& cord_uids) {
+    std::lock_guard<std::mutex> lock(cache_mtx);
+    size_t dropped = 0;
+    for (auto it = cache.begin(); it != cache.end();) {
+        const CacheEntry& entry = it->second;
+        bool stale = !terms.empty() && entry.terms.empty();
+        for (size_t i = 0; i < entry.terms.size() && !stale; i++) stale = terms.count(entry.terms[i]) != 0;
+        if (!stale && entry.result.contains("results")) {
+            for (const auto& r : entry.result["results"]) {
+                if (cord_uids.count(r.value("cord_uid", std::string()))) {
+                    stale = true;
+                    break;
+                }
+            }
+        }
+        if (!stale) {
+            ++it;
+            continue;
+        }
+        lru_list.erase(entry.lru_iter);
+        it = cache.erase(it);
+        dropped++;
+    }
+    if (dropped > 0) save_cache();
+}
+
+// Get result from cache if available, not expired and ranked on snapshot
+// `generation`, update LRU
+json Engine::get_from_cache(const std::string& cache_key, uint64_t generation) {
     auto it = cache.find(cache_key);
     if (it == cache.end()) {
         return json(); // empty json means not found
     }
     
-    // Check if entry is expired
-    if (is_cache_entry_expired(it->second)) {
+    // Check if entry is expired or was ranked on another snapshot
+    if (is_cache_entry_expired(it->second) || it->second.generation != generation) {
         // Remove expired entry
         lru_list.erase(it->second.lru_iter);
         cache.erase(it);
@@ -225,7 +942,8 @@ json Engine::get_from_cache(const std::string& cache_key) {
 }
 
 // Put result in cache with LRU eviction (expired entries evicted first)
-void Engine::put_in_cache(const std::string& cache_key, const json& result) {
+void Engine::put_in_cache(const std::string& cache_key, const json& result, uint64_t generation,
+                          std::vector<std::string> terms) {
     auto now = std::chrono::steady_clock::now();
     
     // Check if already in cache (shouldn't happen, but handle it)
@@ -237,6 +955,8 @@ void Engine::put_in_cache(const std::string& cache_key, const json& result) {
         it->second.result = result;
         it->second.lru_iter = lru_list.begin();
         it->second.timestamp = now;
+        it->second.generation = generation;
+        it->second.terms = std::move(terms);
         return;
     }
     
@@ -274,6 +994,8 @@ void Engine::put_in_cache(const std::string& cache_key, const json& result) {
     entry.result = result;
     entry.lru_iter = lru_list.begin();
     entry.timestamp = now;
+    entry.generation = generation;
+    entry.terms = std::move(terms);
     cache[cache_key] = entry;
     
     // Periodically save cache to disk (every N updates)
@@ -456,160 +1178,595 @@ void Engine::put_ai_summary_in_cache(const std::string& cache_key, const json& r
     }
 }
 
-// Run BM25 search with optional semantic expansion and return JSON results
-json Engine::search(const std::string& query, int k) {
+// Dense per-segment score accumulator.
+// DocIds are dense in [0, seg.N), so a flat array replaces the per-query
+// hash map. Only the slots listed in `touched` are non-zero, and only those are
+// cleared afterwards, so the array can be reused across segments and queries.
+// Scores are float (BM25) or integer (quantized impacts).
+template <typename Score>
+struct ScoreAccumulator {
+    std::vector<Score> score;
+    std::vector<uint32_t> touched;
+
+    // Grow the array to hold at least n docs (new slots start at zero)
+    void prepare(uint32_t n) {
+        if (score.size() < n) score.resize(n, Score(0));
+    }
 
-    // Lock engine during search
-    std::lock_guard<std::mutex> lock(mtx);
+    // Add a positive contribution, remembering the doc on first touch
+    inline void add(uint32_t docId, Score s) {
+        Score& slot = score[docId];
+        if (slot == Score(0)) touched.push_back(docId);
+        slot += s;
+    }
 
-    // Set BM25 parameters and clamp result count to 1..100
-    const float k1 = 1.2f;
-    const float b = 0.75f;
-    const int K = std::max(1, std::min(k, 100));
-    
-    // Check cache first
-    std::string cache_key = make_cache_key(query, K);
-    json cached = get_from_cache(cache_key);
-    if (!cached.is_null()) {
-        // Return cached result with from_cache flag
-        return cached;
+    // Zero only the touched slots so the next segment starts clean
+    void reset() {
+        for (uint32_t d : touched) score[d] = Score(0);
+        touched.clear();
     }
+};
+
+// BM25 score of one posting given the doc's precomputed length norm
+static inline float bm25_score(float idf, float tf, float norm) {
+    return idf * (tf * (BM25_K1 + 1.0f)) / (tf + norm);
+}
 
-    // Tokenize the query string
-    auto qtoks = tokenize(query);
+// Relative slack on WAND upper bounds so float rounding never prunes a hit
+static constexpr float WAND_BOUND_SLACK = 1.0001f;
 
-    // Build base query terms by removing stopwords and short tokens
-    std::vector<std::string> base_terms;
-    base_terms.reserve(qtoks.size());
-    for (auto& t : qtoks) {
-        if (t.size() < 2) continue;
-        if (is_stopword(t)) continue;
-        base_terms.push_back(t);
+// A hit record (score, segment, doc)
+using Hit = SearchHit;
+
+// Min-heap ordering so the weakest of the top K sits on top
+struct HitWorse {
+    bool operator()(const Hit& a, const Hit& b) const { return a.s > b.s; }
+};
+using HitHeap = std::priority_queue<Hit, std::vector<Hit>, HitWorse>;
+
+// Offer a hit to the top-K heap
+static inline void offer_hit(HitHeap& pq, int K, const Hit& h) {
+    if ((int)pq.size() < K) pq.push(h);
+    else if (h.s > pq.top().s) {
+        pq.pop();
+        pq.push(h);
     }
+}
 
-    // Prepare output JSON structure
-    json out;
-    out["query"] = query;
-    out["k"] = K;
-    out["segments"] = (int)segments.size();
-    out["results"] = json::array();
+// Raise a shared score threshold to v (monotonic max)
+static inline void raise_threshold(std::atomic<float>& t, float v) {
+    float cur = t.load(std::memory_order_relaxed);
+    while (v > cur && !t.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
 
-    // Return empty if no usable terms or no segments loaded
-    if (base_terms.empty() || segments.empty()) return out;
+// A query term resolved against one segment's lexicon (idf is corpus-wide)
+struct SegTerm {
+    const LexEntry* e;
+    float qweight;
+    float idf;
+};
+
+// Term-at-a-time scoring of every posting in docIds [lo, hi); returns
+// matched doc count. `allowed` (sorted docIds in the range, may be null)
+// restricts which docs can be hits.
+// Deleted docs (`live`, null when there are none) are accumulated like any
+// other and dropped when the candidates are collected: one bit test per
+// matched doc instead of one per posting.
+static uint64_t score_segment_exhaustive(const Segment& seg, const BM25LengthNorm& norm,
+                                         const LiveDocs* live, uint32_t segId,
+                                         const std::vector<SegTerm>& terms,
+                                         const std::vector<uint32_t>* allowed,
+                                         uint32_t lo, uint32_t hi,
+                                         HitHeap& pq, int K) {
+    // Per-thread scratch accumulator, reused across segments and queries
+    static thread_local ScoreAccumulator<float> acc;
+
+    // Size the accumulator for this segment's docId range
+    acc.prepare(seg.doc_count());
+    const uint32_t* doc_lens = seg.doc_lens.data();
+
+    // Read postings and accumulate BM25 score per doc
+    for (const auto& t : terms) {
+        PostingCursor cur(posting_source(seg, *t.e));
+        cur.advance(lo);
+        for (; cur.doc() < hi; cur.next()) {
+            uint32_t docId = cur.doc();
+            float s = bm25_score(t.idf, (float)cur.tf(), norm(doc_lens[docId]));
+            acc.add(docId, t.qweight * s);
+        }
+    }
 
-    // Expand query using embeddings if semantic search is enabled
-    std::vector<std::pair<std::string, float>> qterms_w;
-    if (sem.enabled) {
-        qterms_w = sem.expand(base_terms,
-                              /*per_term*/ 3,
-                              /*global_topk*/ 5,
-                              /*min_sim*/ 0.55f,
-                              /*alpha*/ 0.6f,
-                              /*max_total_terms*/ 40);
+    // Push top scoring docs from this segment into global heap
+    uint64_t matched = 0;
+    if (allowed) {
+        for (uint32_t docId : *allowed) {
+            float s = acc.score[docId];
+            if (s <= 0.0f || (live && !live->is_live(docId))) continue;
+            offer_hit(pq, K, Hit{s, segId, docId});
+            matched++;
+        }
+    } else if (live) {
+        for (uint32_t docId : acc.touched) {
+            if (!live->is_live(docId)) continue;
+            offer_hit(pq, K, Hit{acc.score[docId], segId, docId});
+            matched++;
+        }
     } else {
-        qterms_w.reserve(base_terms.size());
-        for (const auto& t : base_terms) qterms_w.push_back({t, 1.0f});
+        for (uint32_t docId : acc.touched) {
+            offer_hit(pq, K, Hit{acc.score[docId], segId, docId});
+        }
+        matched = (uint64_t)acc.touched.size();
     }
 
-    // Return empty if expansion produced no terms
-    if (qterms_w.empty()) return out;
+    // Clear touched slots for the next segment
+    acc.reset();
+    return matched;
+}
 
-    // Define a hit record to keep (score, segment, doc)
-    struct Hit {
-        float s;
-        uint32_t segId;
-        uint32_t docId;
+// Document-at-a-time WAND over docIds [lo, hi) of one segment.
+//
+// Each term carries an upper bound on its weighted BM25 contribution, built
+// from the term's (max_tf, min_dl). Cursors are kept sorted by current docId;
+// the pivot is the first cursor at which the summed bounds can beat the
+// current top-K threshold. Docs before the pivot are skipped without scoring.
+// Returns an estimate of the number of matching docs.
+//
+// `shared_theta` is the best K-th score any worker has seen so far: a doc at or
+// below it can never reach the merged top K, so it also bounds this heap.
+static uint64_t score_segment_wand(const Segment& seg, const BM25LengthNorm& norm,
+                                   const LiveDocs* live, uint32_t segId,
+                                   const std::vector<SegTerm>& terms,
+                                   const std::vector<uint32_t>* allowed,
+                                   uint32_t lo, uint32_t hi,
+                                   HitHeap& pq, int K,
+                                   std::atomic<float>& shared_theta) {
+    struct WandTerm {
+        PostingCursor cur;
+        float ub;        // upper bound on this term's weighted contribution
+        uint32_t order;  // position in `terms` (keeps summation order stable)
+        const SvbSkip* blk = nullptr;  // block whose bound is cached in blk_ub
+        float blk_ub = 0.0f;
     };
 
-    // Use a min-heap to keep only top K hits
-    auto cmp = [](const Hit& a, const Hit& b) { return a.s > b.s; };
-    std::priority_queue<Hit, std::vector<Hit>, decltype(cmp)> pq(cmp);
+    // Upper bound of a term inside the block holding its first posting >= doc
+    auto block_bound = [&](WandTerm& w, uint32_t doc, const SvbSkip*& blk) {
+        blk = w.cur.block_for(doc);
+        if (!blk) return w.ub;
+        if (blk != w.blk) {
+            const SegTerm& t = terms[w.order];
+            float min_norm = norm(blk->min_dl);
+            w.blk = blk;
+            w.blk_ub = WAND_BOUND_SLACK * t.qweight *
+                       bm25_score(t.idf, (float)blk->max_tf, min_norm);
+        }
+        return w.blk_ub;
+    };
 
-    // Count how many docs matched across all segments
-    uint64_t total_found = 0;
+    std::vector<WandTerm> wt;
+    wt.reserve(terms.size());
+    for (uint32_t i = 0; i < (uint32_t)terms.size(); i++) {
+        const SegTerm& t = terms[i];
+        float min_norm = norm(t.e->min_dl);
+        float ub = WAND_BOUND_SLACK * t.qweight *
+                   bm25_score(t.idf, (float)t.e->max_tf, min_norm);
+        wt.push_back(WandTerm{
+            PostingCursor(posting_source(seg, *t.e)), ub, i});
+        wt.back().cur.advance(lo);
+    }
+
+    // Pointers sorted by current docId (query term lists are short)
+    std::vector<WandTerm*> order;
+    order.reserve(wt.size());
+    for (auto& w : wt) order.push_back(&w);
+    auto by_doc = [](const WandTerm* a, const WandTerm* b) {
+        return a->cur.doc() < b->cur.doc();
+    };
+
+    std::vector<float> contrib(terms.size(), 0.0f);
+    uint64_t evaluated = 0;
+
+    while (true) {
+        std::sort(order.begin(), order.end(), by_doc);
+
+        // Current entry threshold (any positive score qualifies until K hits)
+        float theta = ((int)pq.size() < K) ? 0.0f : pq.top().s;
+        theta = std::max(theta, shared_theta.load(std::memory_order_relaxed));
+
+        // Find pivot: first cursor where the summed bounds exceed theta
+        // (cursors past the range count as exhausted)
+        float ub_sum = 0.0f;
+        size_t p = 0;
+        for (; p < order.size(); p++) {
+            if (order[p]->cur.doc() >= hi) break;
+            ub_sum += order[p]->ub;
+            if (ub_sum > theta) break;
+        }
+        if (p == order.size() || order[p]->cur.doc() >= hi) break;
+
+        uint32_t pivot = order[p]->cur.doc();
+
+        // Block-Max check: bound the pivot with the per-block maxima of every
+        // cursor up to (and on) the pivot; skip the whole block range if short
+        if (seg.has_skips) {
+            while (p + 1 < order.size() && order[p + 1]->cur.doc() == pivot) p++;
+
+            float blk_sum = 0.0f;
+            uint32_t next_doc = (p + 1 < order.size()) ? order[p + 1]->cur.doc() : END_DOC;
+            WandTerm* widest = order[0];
+            for (size_t i = 0; i <= p; i++) {
+                const SvbSkip* blk = nullptr;
+                blk_sum += block_bound(*order[i], pivot, blk);
+                if (blk && blk->last_doc < END_DOC - 1) {
+                    next_doc = std::min(next_doc, blk->last_doc + 1);
+                }
+                if (order[i]->ub > widest->ub) widest = order[i];
+            }
+
+            if (blk_sum <= theta) {
+                // No doc before next_doc can beat theta: move the strongest term past it
+                widest->cur.advance(std::max(next_doc, pivot + 1));
+                continue;
+            }
+        }
+
+        if (order[0]->cur.doc() == pivot &&
+            ((live && !live->is_live(pivot)) ||
+             (allowed && !std::binary_search(allowed->begin(), allowed->end(), pivot)))) {
+            // Pivot is deleted or fails the phrase filter: step past it without scoring
+            for (auto* w : order) {
+                if (w->cur.doc() != pivot) break;
+                w->cur.next();
+            }
+        } else if (order[0]->cur.doc() == pivot) {
+            // All cursors up to the pivot sit on it: score the doc fully
+            float doc_norm = norm(seg.doc_lens[pivot]);
+            for (auto* w : order) {
+                if (w->cur.doc() != pivot) break;
+                const SegTerm& t = terms[w->order];
+                contrib[w->order] =
+                    t.qweight * bm25_score(t.idf, (float)w->cur.tf(), doc_norm);
+            }
+
+            // Sum in query-term order so scores match exhaustive mode exactly
+            float score = 0.0f;
+            for (float c : contrib) score += c;
+            std::fill(contrib.begin(), contrib.end(), 0.0f);
+
+            offer_hit(pq, K, Hit{score, segId, pivot});
+            if ((int)pq.size() == K) raise_threshold(shared_theta, pq.top().s);
+            evaluated++;
+
+            for (auto* w : order) {
+                if (w->cur.doc() != pivot) break;
+                w->cur.next();
+            }
+        } else {
+            // Move every cursor before the pivot up to the pivot doc
+            for (size_t i = 0; i < p; i++) order[i]->cur.advance(pivot);
+        }
+    }
 
-    // Score documents segment by segment
-    for (uint32_t segId = 0; segId < (uint32_t)segments.size(); segId++) {
-        auto& seg = segments[segId];
+    // Estimate the union size in the range assuming independent terms
+    double miss = 1.0;
+    for (const auto& t : terms) {
+        miss *= 1.0 - std::min(1.0, (double)t.e->df / (double)std::max<uint32_t>(1, seg.N));
+    }
+    uint64_t estimate = (uint64_t)std::llround((double)(hi - lo) * (1.0 - miss));
+    if (allowed) estimate = std::min<uint64_t>(estimate, allowed->size());
+    return std::max(estimate, evaluated);
+}
 
-        // Store BM25 scores per docId inside this segment
-        std::unordered_map<uint32_t, float> score;
-        score.reserve(20000);
+// Fixed-point scale of query term weights (qweight * idf) in impact mode
+static constexpr float IMPACT_QUERY_SCALE = 1024.0f;
+
+// Impact mode stops a segment after max(IMPACT_MIN_BUDGET, N / IMPACT_BUDGET_DIV)
+// postings; the highest-impact postings come first, so the cut drops only
+// the weakest evidence
+static constexpr uint64_t IMPACT_MIN_BUDGET = 1u << 16;
+static constexpr uint64_t IMPACT_BUDGET_DIV = 10;
+
+// Score-at-a-time over impact-ordered postings.
+//
+// Every doc in a (term, impact group) gets the same integer contribution
+// w_t * impact, where w_t is the term's fixed-point query weight, so groups
+// are processed from the largest contribution down and the inner loop is a
+// single integer add. Scores are quantized BM25 (not bit-identical to the
+// other modes). Returns the number of docs touched.
+static uint64_t score_segment_impact(const Segment& seg, const LiveDocs* live, uint32_t segId,
+                                     const std::vector<SegTerm>& terms,
+                                     const std::vector<uint32_t>* allowed,
+                                     HitHeap& pq, int K) {
+    static thread_local ScoreAccumulator<uint32_t> acc;
+    acc.prepare(seg.doc_count());
+
+    // Gather every group of every term with its integer contribution
+    struct Run {
+        uint32_t contrib;
+        ImpactGroup g;
+    };
+    std::vector<Run> runs;
+    std::vector<ImpactGroup> groups;
+    for (const auto& t : terms) {
+        uint32_t w = (uint32_t)std::lround(t.qweight * t.idf * IMPACT_QUERY_SCALE);
+        if (w == 0 || !read_impact_groups(seg, *t.e, groups)) continue;
+        for (const auto& g : groups) runs.push_back(Run{w * g.impact, g});
+    }
+    std::stable_sort(runs.begin(), runs.end(),
+                     [](const Run& a, const Run& b) { return a.contrib > b.contrib; });
+
+    // Accumulate the strongest groups until the postings budget runs out
+    const uint64_t budget = std::max<uint64_t>(IMPACT_MIN_BUDGET, seg.N / IMPACT_BUDGET_DIV);
+    uint64_t processed = 0;
+    std::vector<uint32_t> docs;
+    for (const auto& r : runs) {
+        if (processed >= budget) break;
+        if (!decode_impact_docs(r.g, docs)) continue;
+        for (uint32_t d : docs) {
+            if (d < seg.doc_count()) acc.add(d, r.contrib);
+        }
+        processed += docs.size();
+    }
+
+    // Convert fixed-point totals back to BM25 units
+    const float to_score = impact_step() / IMPACT_QUERY_SCALE;
+    uint64_t matched = 0;
+    if (allowed) {
+        for (uint32_t docId : *allowed) {
+            uint32_t s = acc.score[docId];
+            if (s == 0 || (live && !live->is_live(docId))) continue;
+            offer_hit(pq, K, Hit{(float)s * to_score, segId, docId});
+            matched++;
+        }
+    } else if (live) {
+        for (uint32_t docId : acc.touched) {
+            if (!live->is_live(docId)) continue;
+            offer_hit(pq, K, Hit{(float)acc.score[docId] * to_score, segId, docId});
+            matched++;
+        }
+    } else {
+        for (uint32_t docId : acc.touched) {
+            offer_hit(pq, K, Hit{(float)acc.score[docId] * to_score, segId, docId});
+        }
+        matched = (uint64_t)acc.touched.size();
+    }
 
-        // Process each weighted query term
-        for (const auto& tw : qterms_w) {
-            const std::string& term = tw.first;
-            const float qweight = tw.second;
+    acc.reset();
+    return matched;
+}
 
-            // Skip term if not found in this segment lexicon
-            auto it = seg.lex.find(term);
-            if (it == seg.lex.end()) continue;
+// Segments of more than 2 * RANGE_MIN_DOCS docs are split into docId ranges
+// of at least RANGE_MIN_DOCS docs (at most one per search worker)
+static constexpr uint32_t RANGE_MIN_DOCS = 1u << 15;
 
-            const LexEntry& e = it->second;
-            if (e.df == 0) continue;
+// Score the query against every segment and return its top K hits (best
+// first) plus the matched doc count. Returns false if nothing can be scored.
+static bool rank_query(const IndexSnapshot& snap, ThreadPool* pool,
+                       const ParsedQuery& parsed, int K, SearchMode mode,
+                       std::vector<Hit>& hits, uint64_t& found_out,
+                       std::vector<std::string>* scored_terms = nullptr) {
+    const auto& segments = snap.segments;
+    const auto& base_terms = parsed.terms;
+    hits.clear();
+    found_out = 0;
 
-            // Compute IDF using segment document count and df
-            float idf = bm25_idf(seg.N, e.df);
+    if (base_terms.empty() || segments.empty()) return false;
 
-            // Pick correct inverted file stream (barrels or single file)
-            std::ifstream* invp = nullptr;
-            if (seg.use_barrels) invp = &seg.inv_barrels[e.barrelId];
-            else invp = &seg.inv;
+    // Expand query using embeddings if semantic search is enabled
+    std::vector<std::pair<std::string, float>> qterms_w;
+    if (snap.sem->enabled) {
+        qterms_w = snap.sem->expand(base_terms,
+                              /*per_term*/ 3,
+                              /*global_topk*/ 5,
+                              /*min_sim*/ 0.55f,
+                              /*alpha*/ 0.6f,
+                              /*max_total_terms*/ 40);
+    } else {
+        qterms_w.reserve(base_terms.size());
+        for (const auto& t : base_terms) qterms_w.push_back({t, 1.0f});
+    }
 
-            // Seek to posting list position for this term
-            invp->clear();
-            invp->seekg((std::streamoff)e.offset, std::ios::beg);
+    // Nothing to score if expansion produced no terms
+    if (qterms_w.empty()) return false;
+    if (scored_terms) {
+        for (const auto& tw : qterms_w) scored_terms->push_back(tw.first);
+    }
 
-            // Read postings and accumulate BM25 score per doc
-            for (uint32_t i = 0; i < e.count; i++) {
-                uint32_t docId = read_u32(*invp);
-                uint32_t tf = read_u32(*invp);
+    // Resolve each weighted term once across the segment lexicons and scatter
+    // it to the segments that contain it (keeps query-term order per segment)
+    const auto& stats = snap.stats;
+    std::vector<std::vector<SegTerm>> seg_terms(segments.size());
+    TermStats ts;
+    for (const auto& tw : qterms_w) {
+        // Zero-weight terms cannot change any score
+        if (tw.second <= 0.0f) continue;
+
+        // Skip term if no loaded segment contains it
+        if (!lookup_term(segments, tw.first, ts)) continue;
+
+        // Compute IDF using corpus document count and df
+        float idf = bm25_idf(stats.N, ts.df);
+        for (const auto& se : ts.segs) {
+            seg_terms[se.segId].push_back(SegTerm{se.e, tw.second, idf});
+        }
+    }
 
-                float dl = (float)seg.docs[docId].doc_len;
-                float denom = (float)tf + k1 * (1.0f - b + b * (dl / seg.avgdl));
-                float s = idf * ((float)tf * (k1 + 1.0f)) / denom;
-                score[docId] += qweight * s;
+    // Resolve phrase terms the same way: a segment is a candidate only if
+    // it holds every phrase term, so others are never probed
+    size_t phrase_terms = 0;
+    for (const auto& pc : parsed.phrases) phrase_terms += pc.terms.size();
+    std::vector<std::vector<const LexEntry*>> phrase_ents;
+    std::vector<uint32_t> phrase_hits;
+    if (phrase_terms > 0) {
+        phrase_ents.resize(segments.size());
+        phrase_hits.assign(segments.size(), 0);
+        size_t slot = 0;
+        for (const auto& pc : parsed.phrases) {
+            for (const auto& t : pc.terms) {
+                if (lookup_term(segments, t, ts)) {
+                    for (const auto& se : ts.segs) {
+                        auto& ents = phrase_ents[se.segId];
+                        if (ents.empty()) ents.assign(phrase_terms, nullptr);
+                        ents[slot] = se.e;
+                        phrase_hits[se.segId]++;
+                    }
+                }
+                slot++;
             }
         }
+        for (uint32_t i = 0; i < (uint32_t)segments.size(); i++) {
+            if (phrase_hits[i] != phrase_terms) seg_terms[i].clear();
+        }
+    }
+
+    // Phrase clauses restrict a segment to docs that satisfy them all;
+    // matched once per segment, before its docId ranges are handed out
+    std::vector<std::vector<uint32_t>> phrase_allowed;
+    if (phrase_terms > 0) {
+        std::vector<uint32_t> candidates;
+        for (uint32_t i = 0; i < (uint32_t)segments.size(); i++) {
+            if (!seg_terms[i].empty()) candidates.push_back(i);
+        }
+        phrase_allowed.resize(segments.size());
+        parallel_for(pool, candidates.size(), [&](size_t j) {
+            uint32_t i = candidates[j];
+            phrase_allowed[i] = match_phrases(*segments[i], parsed.phrases, phrase_ents[i]);
+        });
+        for (uint32_t i : candidates) {
+            if (phrase_allowed[i].empty()) seg_terms[i].clear();
+        }
+    }
+
+    // Work items: whole segments, or docId ranges of large ones so a single
+    // big segment still keeps every worker busy. Impact mode walks a
+    // segment's postings by impact, not docId, so its segments stay whole.
+    struct Task {
+        uint32_t segId;
+        uint32_t lo, hi;
+    };
+    const size_t pool_size = pool ? pool->size() : 1;
+    std::vector<Task> tasks;
+    for (uint32_t i = 0; i < (uint32_t)segments.size(); i++) {
+        if (seg_terms[i].empty()) continue;
+        const uint32_t n = segments[i]->doc_count();
+        bool ranged = mode != SearchMode::Impact || !segments[i]->has_impacts;
+        size_t parts = ranged ? std::min<size_t>(pool_size, n / RANGE_MIN_DOCS) : 1;
+        if (parts < 2) parts = 1;
+        for (size_t r = 0; r < parts; r++) {
+            tasks.push_back(Task{i, (uint32_t)((uint64_t)n * r / parts),
+                                 (uint32_t)((uint64_t)n * (r + 1) / parts)});
+        }
+    }
 
-        // Push top scoring docs from this segment into global heap
-        for (auto& kv : score) {
-            Hit h{kv.second, segId, kv.first};
-            if ((int)pq.size() < K) pq.push(h);
-            else if (h.s > pq.top().s) {
-                pq.pop();
-                pq.push(h);
+    // Hand out the largest items first so workers finish close together
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Task& a, const Task& b) {
+        return a.hi - a.lo > b.hi - b.lo;
+    });
+    const uint32_t ntasks = (uint32_t)tasks.size();
+
+    // Score one item into a worker-local heap. Doc lengths are scaled
+    // against the corpus avgdl so scores compare across segments.
+    const BM25LengthNorm norm(snap.stats.avgdl);
+    std::atomic<float> shared_theta{0.0f};
+    auto run_task = [&](const Task& task, HitHeap& heap) -> uint64_t {
+        const uint32_t segId = task.segId;
+        const Segment& seg = *segments[segId];
+        const LiveDocs* live = snap.live[segId].get();
+
+        // The phrase matches inside this item's range
+        std::vector<uint32_t> slice;
+        const std::vector<uint32_t>* filter = nullptr;
+        if (phrase_terms > 0) {
+            filter = &phrase_allowed[segId];
+            if (task.lo > 0 || task.hi < seg.doc_count()) {
+                slice.assign(std::lower_bound(filter->begin(), filter->end(), task.lo),
+                             std::lower_bound(filter->begin(), filter->end(), task.hi));
+                if (slice.empty()) return 0;
+                filter = &slice;
             }
         }
 
-        // Add count of matched docs from this segment
-        total_found += (uint64_t)score.size();
+        // Segments without bounds.bin cannot be pruned safely, and segments
+        // built without impacts are scored exactly (same BM25 scale)
+        if (mode == SearchMode::Wand && seg.has_bounds)
+            return score_segment_wand(seg, norm, live, segId, seg_terms[segId], filter,
+                                      task.lo, task.hi, heap, K, shared_theta);
+        if (mode == SearchMode::Impact && seg.has_impacts)
+            return score_segment_impact(seg, live, segId, seg_terms[segId], filter, heap, K);
+        return score_segment_exhaustive(seg, norm, live, segId, seg_terms[segId], filter,
+                                        task.lo, task.hi, heap, K);
+    };
+
+    // Each worker pulls items and keeps its own top-K heap and match count.
+    // The calling thread runs the first worker; a worker whose helper is still
+    // queued behind other searches is run by whichever thread gets there first,
+    // and by then every item is claimed, so it returns at once.
+    size_t workers = pool ? std::min<size_t>(pool->size(), ntasks) : 1;
+    std::vector<HitHeap> heaps(workers);
+    std::vector<uint64_t> found(workers, 0);
+    std::atomic<uint32_t> next_task{0};
+
+    auto worker = [&](size_t w) {
+        for (uint32_t i; (i = next_task.fetch_add(1)) < ntasks;) {
+            found[w] += run_task(tasks[i], heaps[w]);
+        }
+    };
+
+    parallel_for(pool, workers, worker);
+
+    // Merge worker heaps into the global top K
+    HitHeap pq;
+    uint64_t total_found = 0;
+    for (size_t w = 0; w < workers; w++) {
+        total_found += found[w];
+        while (!heaps[w].empty()) {
+            offer_hit(pq, K, heaps[w].top());
+            heaps[w].pop();
+        }
     }
 
     // Extract hits from heap into sorted list (highest score first)
-    std::vector<Hit> hits;
     while (!pq.empty()) {
         hits.push_back(pq.top());
         pq.pop();
     }
     std::reverse(hits.begin(), hits.end());
-    out["found"] = total_found;
+    found_out = total_found;
+    return true;
+
+}
 
+// Build JSON result entries for hits, fetching their metadata in one batch
+static json hydrate_hits(const IndexSnapshot& snap, const Hit* hits, size_t n) {
+    const auto& segments = snap.segments;
+    const auto& seg_names = snap.seg_names;
+
+    // Look up metadata rows for all hits, then fetch them in one batch
+    std::vector<std::string> hit_uids;
+    std::vector<const MetaInfo*> hit_rows;
+    hit_uids.reserve(n);
+    hit_rows.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+        const Hit& h = hits[i];
+        hit_uids.emplace_back(segments[h.segId]->cord_uid(h.docId));
+        auto it = snap.uid_to_meta->find(hit_uids.back());
+        hit_rows.push_back(it != snap.uid_to_meta->end() ? &it->second : nullptr);
+    }
+    std::vector<MetaData> metas = snap.metadata->fetch_batch(hit_rows);
+
+    json results = json::array();
     // Convert hits into JSON output entries
-    for (auto& h : hits) {
-        auto& d = segments[h.segId].docs[h.docId];
+    for (size_t i = 0; i < n; i++) {
+        const Hit& h = hits[i];
         json r;
         r["score"] = h.s;
         r["segment"] = seg_names[h.segId];
         r["docId"] = h.docId;
-        r["cord_uid"] = d.cord_uid;
+        r["cord_uid"] = hit_uids[i];
+
+        // Metadata fields fetched on-demand from file (title, url, author, etc.)
+        if (hit_rows[i]) {
+            const MetaData& meta = metas[i];
 
-        // Fetch ALL metadata fields on-demand from file (title, url, author, etc.)
-        auto it = uid_to_meta.find(d.cord_uid);
-        if (it != uid_to_meta.end()) {
-            // Fetch metadata on-demand from file
-            MetaData meta = fetch_metadata(metadata_csv_path, it->second);
-            
             // Add title from metadata (not from docs structure)
             if (!meta.title.empty()) r["title"] = meta.title;
             
@@ -623,12 +1780,192 @@ json Engine::search(const std::string& query, int k) {
         }
         // Note: json_relpath removed - not needed in API response
 
-        out["results"].push_back(r);
+        results.push_back(r);
     }
     
-    // Store result in cache before returning
-    put_in_cache(cache_key, out);
+    return results;
+}
+
+// Opaque page cursor: "<snapshot generation>.<offset>"
+static std::string make_page_cursor(uint64_t generation, size_t offset) {
+    return std::to_string(generation) + "." + std::to_string(offset);
+}
+
+static bool parse_page_cursor(const std::string& cursor, uint64_t& generation, size_t& offset) {
+    size_t dot = cursor.find('.');
+    if (dot == std::string::npos || dot == 0 || dot + 1 >= cursor.size()) return false;
+    for (size_t i = 0; i < cursor.size(); i++) {
+        if (i != dot && !std::isdigit((unsigned char)cursor[i])) return false;
+    }
+    try {
+        generation = std::stoull(cursor.substr(0, dot));
+        offset = (size_t)std::stoull(cursor.substr(dot + 1));
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// Name of a search mode as used in requests, responses and cache keys
+static const char* mode_name(SearchMode mode) {
+    switch (mode) {
+        case SearchMode::Wand: return "wand";
+        case SearchMode::Impact: return "impact";
+        default: return "exhaustive";
+    }
+}
+
+// Run BM25 search with optional semantic expansion and return JSON results
+json Engine::search(const std::string& query, int k, SearchMode mode) {
+
+    // Clamp result count to 1..100
+    const int K = std::max(1, std::min(k, 100));
+    const bool exact = (mode == SearchMode::Exhaustive);
+
+    // Pin the current index snapshot for the whole query
+    auto snap = snapshot();
+
+    // Check cache first (exhaustive keeps the original key format)
+    std::string cache_key = make_cache_key(query, K);
+    if (!exact) cache_key += std::string("|") + mode_name(mode);
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        json cached = get_from_cache(cache_key, snap->generation);
+        if (!cached.is_null()) {
+            // Return cached result with from_cache flag
+            return cached;
+        }
+    }
+
+    // Split out "quoted phrases" and build base query terms
+    // (stopwords and short tokens removed, phrase terms included)
+    ParsedQuery parsed = parse_query(query);
 
+    // Prepare output JSON structure
+    json out;
+    out["query"] = query;
+    out["k"] = K;
+    out["mode"] = mode_name(mode);
+    out["segments"] = (int)snap->segments.size();
+    out["results"] = json::array();
+
+    // Return empty if no usable terms, segments or expanded terms
+    std::vector<Hit> hits;
+    uint64_t found = 0;
+    std::vector<std::string> terms;
+    if (!rank_query(*snap, search_pool.get(), parsed, K, mode, hits, found, &terms)) return out;
+
+    out["found"] = found;
+    if (!exact) out["found_is_estimate"] = true;
+    out["results"] = hydrate_hits(*snap, hits.data(), hits.size());
+
+    // A full page with more matches left can be continued with a cursor
+    if ((int)hits.size() == K && found > (uint64_t)K) {
+        out["next_cursor"] = make_page_cursor(snap->generation, (size_t)K);
+    }
+
+    // Store result in cache before returning, unless a RAM add or delete
+    // published since (its forget_cached() may already have run)
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        if (snapshot()->ram_epoch == snap->ram_epoch) {
+            put_in_cache(cache_key, out, snap->generation, std::move(terms));
+        }
+    }
+
+    return out;
+}
+
+// Return hits [offset, offset+k) of the query ranking. The first page goes
+// through search(); deeper pages are sliced from a per-query candidate set of
+// the top MAX_PAGE_DEPTH hits, ranked once per snapshot generation.
+json Engine::search_page(const std::string& query, int k, size_t offset,
+                         const std::string& cursor, SearchMode mode) {
+    const int K = std::max(1, std::min(k, 100));
+    const bool exact = (mode == SearchMode::Exhaustive);
+    auto snap = snapshot();
+
+    // A cursor carries its own offset and must match the current snapshot
+    if (!cursor.empty()) {
+        uint64_t generation = 0;
+        if (!parse_page_cursor(cursor, generation, offset)) {
+            json err;
+            err["error"] = "invalid cursor";
+            return err;
+        }
+        if (generation != snap->generation) {
+            json err;
+            err["error"] = "cursor expired: index was reloaded, restart from the first page";
+            err["cursor_expired"] = true;
+            return err;
+        }
+    }
+
+    if (offset == 0) return search(query, K, mode);
+
+    json out;
+    out["query"] = query;
+    out["k"] = K;
+    out["offset"] = offset;
+    out["mode"] = mode_name(mode);
+    out["segments"] = (int)snap->segments.size();
+    out["results"] = json::array();
+
+    // Pages stop at the candidate set depth
+    if (offset >= MAX_PAGE_DEPTH) return out;
+
+    // Reuse the candidate set if it was ranked on this generation; without a
+    // cursor, only if no RAM add or delete came after it
+    std::string set_key = query + "|" + mode_name(mode);
+    std::shared_ptr<const ResultSet> rs;
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        auto it = result_sets.find(set_key);
+        if (it != result_sets.end() && it->second.set->generation == snap->generation &&
+            (!cursor.empty() || it->second.set->ram_epoch == snap->ram_epoch)) {
+            result_set_lru.splice(result_set_lru.begin(), result_set_lru, it->second.lru_iter);
+            rs = it->second.set;
+            out["from_cache"] = true;
+        }
+    }
+
+    if (!rs) {
+        auto built = std::make_shared<ResultSet>();
+        built->generation = snap->generation;
+        built->ram_epoch = snap->ram_epoch;
+        built->snap = snap;
+        ParsedQuery parsed = parse_query(query);
+        if (!rank_query(*snap, search_pool.get(), parsed, (int)MAX_PAGE_DEPTH, mode,
+                        built->hits, built->found)) {
+            return out;
+        }
+        rs = built;
+
+        // Insert (or replace a stale entry), evicting the least recently used set
+        std::lock_guard<std::mutex> lock(cache_mtx);
+        auto it = result_sets.find(set_key);
+        if (it != result_sets.end()) {
+            result_set_lru.erase(it->second.lru_iter);
+            result_sets.erase(it);
+        }
+        while (result_sets.size() >= MAX_RESULT_SETS && !result_set_lru.empty()) {
+            result_sets.erase(result_set_lru.back());
+            result_set_lru.pop_back();
+        }
+        result_set_lru.push_front(set_key);
+        result_sets[set_key] = ResultSetEntry{rs, result_set_lru.begin()};
+    }
+
+    out["found"] = rs->found;
+    if (!exact) out["found_is_estimate"] = true;
+
+    size_t end = std::min(rs->hits.size(), offset + (size_t)K);
+    if (offset < end) {
+        out["results"] = hydrate_hits(*rs->snap, rs->hits.data() + offset, end - offset);
+    }
+    if (end < rs->hits.size()) {
+        out["next_cursor"] = make_page_cursor(snap->generation, end);
+    }
     return out;
 }
 
@@ -650,6 +1987,7 @@ void Engine::save_cache() {
             json item;
             item["key"] = key;
             item["result"] = entry.result;
+            item["terms"] = entry.terms;
             
             // Store timestamp as milliseconds since epoch for portability
             auto epoch_time = std::chrono::time_point_cast<std::chrono::milliseconds>(entry.timestamp);
@@ -674,8 +2012,10 @@ void Engine::save_cache() {
     }
 }
 
-// Load search cache from JSON file
+// Load search cache from JSON file (entries count as ranked on the current
+// snapshot, the one the saving run last served)
 void Engine::load_cache() {
+    const uint64_t generation = snapshot()->generation;
     try {
         fs::path cache_file = "search_cache.json";
         
@@ -716,6 +2056,11 @@ void Engine::load_cache() {
             std::string key = item["key"];
             json result = item["result"];
             
+            // Saved cursors name the saving run's generations
+            if (result.contains("next_cursor") && result.contains("k")) {
+                result["next_cursor"] = make_page_cursor(generation, result["k"].get<size_t>());
+            }
+            
             // Restore timestamp
             int64_t epoch_millis = item["timestamp"];
             auto epoch_time = std::chrono::milliseconds(epoch_millis);
@@ -737,6 +2082,8 @@ void Engine::load_cache() {
             entry.result = result;
             entry.lru_iter = --lru_list.end();
             entry.timestamp = timestamp;
+            entry.generation = generation;
+            if (item.contains("terms")) entry.terms = item["terms"].get<std::vector<std::string>>();
             cache[key] = entry;
             loaded++;
         }
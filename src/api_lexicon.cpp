@@ -0,0 +1,68 @@
+#include "api_lexicon.hpp"
+
+#include <cstring>
+
+namespace cord19 {
+
+bool Lexicon::open(ByteSpan bytes, std::string& err) {
+    mapped_ = false;
+    if (bytes.size < sizeof(MphHeader)) { err = "lexicon.mph too short"; return false; }
+    std::memcpy(&h_, bytes.data, sizeof(h_));
+    if (std::memcmp(h_.magic, MPH_MAGIC, sizeof(MPH_MAGIC)) != 0) { err = "lexicon.mph: bad magic"; return false; }
+    if (h_.version != MPH_VERSION) { err = "lexicon.mph: unsupported version " + std::to_string(h_.version); return false; }
+    if (h_.bucket_count == 0 || h_.key_count > h_.entry_count) { err = "lexicon.mph: bad counts"; return false; }
+
+    // Every table must lie inside the file; entries are read in place
+    ByteSpan pilots = bytes.sub(h_.pilots_offset, (uint64_t)h_.bucket_count * sizeof(uint32_t));
+    ByteSpan slots = bytes.sub(h_.slots_offset, (uint64_t)h_.key_count * sizeof(uint32_t));
+    ByteSpan entries = bytes.sub(h_.entries_offset, (uint64_t)h_.entry_count * sizeof(LexEntry));
+    ByteSpan offsets = bytes.sub(h_.term_offsets_offset, ((uint64_t)h_.entry_count + 1) * sizeof(uint32_t));
+    ByteSpan pool = bytes.sub(h_.pool_offset, h_.pool_size);
+    if (pilots.empty() || (h_.key_count && slots.empty()) || (h_.entry_count && entries.empty()) ||
+        offsets.empty() || (h_.pool_size && pool.empty())) {
+        err = "lexicon.mph: table out of range";
+        return false;
+    }
+    if ((uintptr_t)entries.data % alignof(LexEntry) != 0 || (uintptr_t)pilots.data % alignof(uint32_t) != 0 ||
+        (uintptr_t)slots.data % alignof(uint32_t) != 0 || (uintptr_t)offsets.data % alignof(uint32_t) != 0) {
+        err = "lexicon.mph: misaligned tables";
+        return false;
+    }
+
+    pilots_ = reinterpret_cast<const uint32_t*>(pilots.data);
+    slots_ = reinterpret_cast<const uint32_t*>(slots.data);
+    entries_ = reinterpret_cast<const LexEntry*>(entries.data);
+    term_offsets_ = reinterpret_cast<const uint32_t*>(offsets.data);
+    pool_ = reinterpret_cast<const char*>(pool.data);
+    map.clear();
+    mapped_ = true;
+    return true;
+}
+
+// Term bytes of tid (checked against the pool: offsets are not validated at open)
+bool Lexicon::term_of(uint32_t tid, std::string_view& out) const {
+    uint32_t begin = term_offsets_[tid], end = term_offsets_[tid + 1];
+    if (begin > end || end > h_.pool_size) return false;
+    out = std::string_view(pool_ + begin, end - begin);
+    return true;
+}
+
+const LexEntry* Lexicon::find(std::string_view term) const {
+    if (!mapped_) {
+        auto it = map.find(std::string(term));
+        return it == map.end() ? nullptr : &it->second;
+    }
+    if (h_.key_count == 0) return nullptr;
+
+    uint64_t h = mph_hash(term.data(), term.size(), h_.seed);
+    uint32_t slot = mph_slot(h, pilots_[mph_bucket(h, h_.bucket_count)], h_.key_count);
+    uint32_t tid = slots_[slot];
+    if (tid >= h_.entry_count) return nullptr;
+
+    // Terms outside the key set land on some other term's slot
+    std::string_view stored;
+    if (!term_of(tid, stored) || stored != term) return nullptr;
+    return &entries_[tid];
+}
+
+} // namespace cord19
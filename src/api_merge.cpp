@@ -0,0 +1,383 @@
+#include "api_merge.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "api_dictionary.hpp"
+#include "api_postings.hpp"
+#include "api_segment.hpp"
+#include "barrel_writer.hpp"
+#include "indexio.hpp"
+#include "live_docs.hpp"
+#include "segment_file.hpp"
+
+namespace cord19 {
+
+// Tier of a segment: floor(log_fanout(docs))
+static uint32_t merge_tier(uint32_t docs, uint32_t fanout) {
+    uint32_t tier = 0;
+    for (uint64_t size = fanout; docs >= size; size *= fanout) tier++;
+    return tier;
+}
+
+bool pick_merge(const std::vector<uint32_t>& doc_counts, const MergePolicy& policy,
+                size_t& first, size_t& count) {
+    const uint32_t fanout = std::max<uint32_t>(2, policy.fanout);
+    if (doc_counts.size() < fanout) return false;
+
+    std::vector<uint32_t> tiers(doc_counts.size());
+    uint32_t max_tier = 0;
+    for (size_t i = 0; i < doc_counts.size(); i++) {
+        tiers[i] = merge_tier(doc_counts[i], fanout);
+        max_tier = std::max(max_tier, tiers[i]);
+    }
+
+    // Lowest tier with `fanout` adjacent segments in it (or just below it)
+    for (uint32_t t = 0; t <= max_tier; t++) {
+        size_t run = 0;
+        for (size_t i = 0; i < tiers.size(); i++) {
+            bool in_tier = tiers[i] == t || (t > 0 && tiers[i] == t - 1);
+            run = in_tier ? run + 1 : 0;
+            if (run == fanout) {
+                first = i + 1 - fanout;
+                count = fanout;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Copy the docs.bin records of a source segment's live docs
+static bool copy_doc_records(Segment& seg, const LiveDocs& live, std::ofstream& out) {
+    ByteSpan bytes;
+    if (!seg.store.get("docs.bin", bytes, MapAccess::Sequential)) return false;
+    ByteReader in(bytes);
+    uint32_t n = in.u32();
+    if (n != live.doc_count) return false;
+    for (uint32_t i = 0; i < n && in.ok(); i++) {
+        std::string uid = in.str();
+        std::string title = in.str();
+        std::string relpath = in.str();
+        uint32_t doc_len = in.u32();
+        if (!live.is_live(i)) continue;
+        write_string(out, uid);
+        write_string(out, title);
+        write_string(out, relpath);
+        write_u32(out, doc_len);
+    }
+    seg.store.release("docs.bin");
+    return in.ok() && n == seg.doc_lens.size();
+}
+
+bool merge_segments(const std::vector<fs::path>& srcs, const fs::path& outdir, std::string& err) {
+    std::vector<Segment> segs(srcs.size());
+    std::vector<LiveDocs> live(srcs.size());
+    for (size_t i = 0; i < srcs.size(); i++) {
+        if (!load_segment(srcs[i], segs[i])) { err = "cannot load segment " + srcs[i].string(); return false; }
+        // Damaged postings would come out under fresh checksums
+        if (!segs[i].store.verify_bulk(err)) { err = srcs[i].string() + ": " + err; return false; }
+        if (!read_live_docs(srcs[i], segs[i].doc_count(), live[i], err)) return false;
+    }
+
+    // Live docs are concatenated in source order; deleted ones are dropped,
+    // so each source gets a docId map (END_DOC for a deleted doc)
+    std::vector<std::vector<uint32_t>> doc_map(segs.size());
+    std::vector<uint32_t> doc_lens;
+    uint64_t total_len = 0;
+    bool positions = !segs.empty();
+    bool impacts = !segs.empty();
+    for (size_t i = 0; i < segs.size(); i++) {
+        if ((uint64_t)doc_lens.size() + segs[i].doc_lens.size() >= END_DOC) { err = "merged segment too large"; return false; }
+        doc_map[i].assign(segs[i].doc_lens.size(), END_DOC);
+        for (uint32_t d = 0; d < segs[i].doc_count(); d++) {
+            if (!live[i].is_live(d)) continue;
+            doc_map[i][d] = (uint32_t)doc_lens.size();
+            doc_lens.push_back(segs[i].doc_lens[d]);
+            total_len += segs[i].doc_lens[d];
+        }
+        positions = positions && segs[i].has_positions;
+        impacts = impacts && segs[i].has_impacts;
+    }
+    if (doc_lens.empty()) { err = "every document in the run is deleted"; return false; }
+
+    // Walk the union of the sources' terms in sorted order; merged termIds follow it
+    std::vector<const TermDictionary*> dicts;
+    for (const auto& seg : segs) dicts.push_back(&seg.dict);
+
+    std::vector<std::string> terms;
+    std::vector<std::vector<Posting>> inverted;
+    std::vector<std::vector<uint32_t>> term_positions;
+    std::vector<uint32_t> pos;
+    std::vector<Posting> kept;
+    bool ok = true;
+    scan_prefix(dicts, "", [&](std::string_view term, uint64_t) {
+        std::vector<Posting> plist;
+        std::vector<uint32_t> plist_pos;
+        const uint64_t h = bloom_term_hash(term);
+        for (size_t i = 0; i < segs.size() && ok; i++) {
+            if (!segs[i].filter.may_contain(h)) continue;
+            const LexEntry* e = segs[i].lex.find(term);
+            if (!e || e->df == 0) continue;
+
+            // Postings of deleted docs are skipped; `kept` remembers which
+            uint64_t slots = 0;
+            uint32_t seen = 0;
+            kept.clear();
+            for (PostingCursor c(posting_source(segs[i], *e)); c.doc() != END_DOC; c.next()) {
+                uint32_t d = c.doc() < doc_map[i].size() ? doc_map[i][c.doc()] : END_DOC;
+                kept.push_back(Posting{d, c.tf()});
+                if (d != END_DOC) plist.push_back(Posting{d, c.tf()});
+                slots += c.tf();
+                seen++;
+            }
+            if (seen != e->df) {
+                err = "truncated postings for '" + std::string(term) + "' in " + srcs[i].string();
+                ok = false;
+            } else if (positions) {
+                if (slots > UINT32_MAX || !read_positions(segs[i], *e, 0, (uint32_t)slots, pos)) {
+                    err = "truncated positions for '" + std::string(term) + "' in " + srcs[i].string();
+                    ok = false;
+                } else {
+                    // Positions are laid out posting by posting, tf slots each
+                    size_t at = 0;
+                    for (const Posting& p : kept) {
+                        if (p.docId != END_DOC) plist_pos.insert(plist_pos.end(), pos.begin() + at, pos.begin() + at + p.tf);
+                        at += p.tf;
+                    }
+                }
+            }
+        }
+        if (!ok) return false;
+
+        // Terms left only in deleted docs disappear
+        if (plist.empty()) return true;
+        terms.emplace_back(term);
+        inverted.push_back(std::move(plist));
+        if (positions) term_positions.push_back(std::move(plist_pos));
+        return true;
+    });
+    if (!ok) return false;
+
+    fs::create_directories(outdir);
+
+    // stats.bin
+    {
+        std::ofstream out(outdir / "stats.bin", std::ios::binary);
+        write_u32(out, (uint32_t)doc_lens.size());
+        write_f32(out, doc_lens.empty() ? 0.0f : (float)((double)total_len / (double)doc_lens.size()));
+    }
+
+    // docs.bin
+    {
+        std::ofstream out(outdir / "docs.bin", std::ios::binary);
+        write_u32(out, (uint32_t)doc_lens.size());
+        for (size_t i = 0; i < segs.size(); i++) {
+            if (!copy_doc_records(segs[i], live[i], out)) { err = "bad docs.bin in " + srcs[i].string(); return false; }
+        }
+    }
+
+    // terms.bin
+    {
+        std::ofstream out(outdir / "terms.bin", std::ios::binary);
+        write_u32(out, (uint32_t)terms.size());
+        for (auto& t : terms) write_string(out, t);
+    }
+
+    // forward.bin (+ forward_pos.bin), transposed from the postings so the
+    // merged segment can be rebuilt by the lexicon tool like any other.
+    // Per doc: (termId, tf, first position slot), in termId order.
+    {
+        struct FwdEntry { uint32_t tid; uint32_t tf; uint64_t slot; };
+        std::vector<std::vector<FwdEntry>> forward(doc_lens.size());
+        for (uint32_t tid = 0; tid < (uint32_t)inverted.size(); tid++) {
+            uint64_t slot = 0;
+            for (const Posting& p : inverted[tid]) {
+                forward[p.docId].push_back(FwdEntry{tid, p.tf, slot});
+                slot += p.tf;
+            }
+        }
+
+        std::ofstream out(outdir / "forward.bin", std::ios::binary);
+        write_u32(out, (uint32_t)forward.size());
+        for (auto& vec : forward) {
+            write_u32(out, (uint32_t)vec.size());
+            for (auto& f : vec) {
+                write_u32(out, f.tid);
+                write_u32(out, f.tf);
+            }
+        }
+
+        if (positions) {
+            std::ofstream pos_out(outdir / "forward_pos.bin", std::ios::binary);
+            write_u32(pos_out, (uint32_t)forward.size());
+            for (auto& vec : forward) {
+                for (auto& f : vec) {
+                    pos_out.write((const char*)&term_positions[f.tid][f.slot], (std::streamsize)(f.tf * sizeof(uint32_t)));
+                }
+            }
+        }
+    }
+
+    // Postings were appended source by source, so every list is in docId order
+    if (!write_barrelized_index(outdir, terms, inverted, doc_lens, err, positions ? &term_positions : nullptr))
+        return false;
+    if (impacts && !write_impact_index(outdir, inverted, doc_lens, err)) return false;
+    return pack_segment(outdir, err);
+}
+
+bool merge_index_step(const fs::path& index_dir, const MergePolicy& policy, bool all,
+                      std::vector<std::string>& replaced, std::string& err) {
+    replaced.clear();
+    std::vector<std::string> names = list_segments(index_dir);
+    if (names.size() < 2) return true;
+
+    // Live doc counts come from stats.bin and live.bin alone; nothing else is
+    // loaded. Segments thinned out by deletes drop to a lower tier.
+    std::vector<uint32_t> doc_counts, deleted_counts;
+    std::vector<char> bytes;
+    LiveDocs live;
+    for (const auto& name : names) {
+        fs::path segdir = index_dir / "segments" / name;
+        uint32_t n = 0;
+        if (!read_segment_bytes(segdir, "stats.bin", bytes, err) || bytes.size() < sizeof(n)) {
+            err = name + ": " + err;
+            return false;
+        }
+        std::memcpy(&n, bytes.data(), sizeof(n));
+        if (!read_live_docs(segdir, n, live, err)) return false;
+        doc_counts.push_back(n - live.deleted);
+        deleted_counts.push_back(live.deleted);
+    }
+
+    size_t first = 0, count = names.size();
+    if (!all && !pick_merge(doc_counts, policy, first, count)) return true;
+
+    std::vector<std::string> run(names.begin() + first, names.begin() + first + count);
+    std::vector<fs::path> srcs;
+    uint64_t live_docs = 0;
+    for (size_t i = first; i < first + count; i++) live_docs += doc_counts[i];
+    for (const auto& name : run) srcs.push_back(index_dir / "segments" / name);
+
+    // A run with nothing left in it is dropped without a replacement (but an
+    // index keeps at least one segment)
+    if (live_docs == 0 && count == names.size()) return true;
+    std::string out_name;
+    fs::path outdir;
+    std::error_code ec;
+    if (live_docs > 0) {
+        {
+            // Claim the name while no other writer is picking one
+            ManifestLock lock(index_dir);
+            if (!lock.ok()) {
+                err = "cannot lock " + index_lock_path(index_dir).string();
+                return false;
+            }
+            out_name = next_segment_name(index_dir);
+            outdir = index_dir / "segments" / out_name;
+            fs::create_directories(outdir, ec);
+        }
+        if (!merge_segments(srcs, outdir, err)) {
+            fs::remove_all(outdir, ec);
+            return false;
+        }
+    }
+
+    // Swap the run for the merged segment in the current manifest (segments
+    // may have been appended meanwhile). Without a manifest the folder scan
+    // already lists the new segment.
+    ManifestLock lock(index_dir);
+    if (!lock.ok()) {
+        err = "cannot lock " + index_lock_path(index_dir).string();
+        if (!outdir.empty()) fs::remove_all(outdir, ec);
+        return false;
+    }
+
+    // Docs deleted while merging would come back: retry on the next round.
+    // Deletes write live.bin under this lock, so none can slip in between
+    // this check and the swap; a bit is only ever cleared, so a count that
+    // did not grow means an unchanged bitmap.
+    for (size_t i = 0; i < srcs.size(); i++) {
+        const size_t k = first + i;
+        bool changed = !read_live_docs(srcs[i], doc_counts[k] + deleted_counts[k], live, err);
+        if (!changed && live.deleted != deleted_counts[k]) {
+            err = "documents deleted during merge";
+            changed = true;
+        }
+        if (changed) {
+            if (!outdir.empty()) fs::remove_all(outdir, ec);
+            return false;
+        }
+    }
+
+    std::vector<std::string> current = list_segments(index_dir);
+    if (!out_name.empty()) current.erase(std::remove(current.begin(), current.end(), out_name), current.end());
+    auto at = std::search(current.begin(), current.end(), run.begin(), run.end());
+    if (at == current.end()) {
+        err = "manifest changed during merge";
+        if (!outdir.empty()) fs::remove_all(outdir, ec);
+        return false;
+    }
+    at = current.erase(at, at + (std::ptrdiff_t)run.size());
+    if (!out_name.empty()) current.insert(at, out_name);
+    if (!save_manifest(index_dir / "manifest.bin", current)) {
+        err = "failed to write manifest.bin";
+        if (!outdir.empty()) fs::remove_all(outdir, ec);
+        return false;
+    }
+
+    std::cerr << "[merge] " << run.size() << " segments (" << run.front() << " .. " << run.back()
+              << ") -> " << (out_name.empty() ? std::string("nothing (all docs deleted)") : out_name) << "\n";
+    replaced = std::move(run);
+    return true;
+}
+
+void remove_segments(const fs::path& index_dir, const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        std::error_code ec;
+        fs::remove_all(index_dir / "segments" / name, ec);
+        if (ec) std::cerr << "[merge] could not remove " << name << ": " << ec.message() << "\n";
+    }
+}
+
+void BackgroundMerger::start(std::chrono::seconds interval) {
+    stop();
+    stopping_ = false;
+    thread_ = std::thread([this, interval] { run(interval); });
+}
+
+void BackgroundMerger::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) thread_.join();
+}
+
+void BackgroundMerger::run(std::chrono::seconds interval) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!cv_.wait_for(lock, interval, [this] { return stopping_; })) {
+        lock.unlock();
+
+        // Merge until the policy is satisfied
+        std::vector<std::string> removed, replaced;
+        std::string err;
+        while (merge_index_step(index_dir_, policy_, false, replaced, err) && !replaced.empty()) {
+            removed.insert(removed.end(), replaced.begin(), replaced.end());
+        }
+        if (!err.empty()) std::cerr << "[merge] " << err << "\n";
+
+        // Old segments go only once the engine has switched to the merged ones
+        if (!removed.empty()) {
+            if (!on_merged_ || on_merged_()) remove_segments(index_dir_, removed);
+            else std::cerr << "[merge] reload failed, keeping " << removed.size() << " merged segments\n";
+        }
+        lock.lock();
+    }
+}
+
+} // namespace cord19
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -107,7 +108,8 @@ static std::string first_author_et_al(const std::string& authors_raw) {
 
 // Load metadata CSV byte positions and map cord_uid to file positions
 void load_metadata_uid_meta(const fs::path& metadata_csv,
-                            std::unordered_map<std::string, MetaInfo>& uid_to_meta) {
+                            std::unordered_map<std::string, MetaInfo>& uid_to_meta,
+                            uint64_t from_offset) {
 
     // Open metadata CSV file
     std::ifstream in(metadata_csv, std::ios::binary);
@@ -144,6 +146,16 @@ void load_metadata_uid_meta(const fs::path& metadata_csv,
         return;
     }
 
+    // Skip rows loaded before (the header still names the columns)
+    if (from_offset > current_pos) {
+        in.seekg((std::streamoff)from_offset);
+        if (!in) {
+            std::cerr << "[metadata] FAILED seek to " << from_offset << "\n";
+            return;
+        }
+        current_pos = from_offset;
+    }
+
     std::string line;
     size_t loaded = 0, bad = 0;
 
@@ -184,67 +196,106 @@ void load_metadata_uid_meta(const fs::path& metadata_csv,
               << " map_size=" << uid_to_meta.size() << "\n";
 }
 
-// Fetch full metadata from file on-demand using stored byte position
-MetaData fetch_metadata(const fs::path& metadata_csv, const MetaInfo& meta_info) {
-    MetaData result;
-    
-    // Open file and seek to the stored position
-    std::ifstream in(metadata_csv, std::ios::binary);
-    if (!in) {
+// Map metadata.csv and cache the header's column indices
+bool MetadataStore::open(const fs::path& metadata_csv) {
+    path_ = metadata_csv;
+    cols_ = Columns{};
+    open_ = false;
+
+    if (!file_.open(metadata_csv, MapAccess::Random)) {
         std::cerr << "[metadata] FAILED to open file for fetch: "
                   << metadata_csv.string() << "\n";
-        return result;
+        return false;
     }
-    
-    // Seek to the row position
-    in.seekg(meta_info.file_offset);
-    
-    // Read the row
-    std::string line;
-    if (!std::getline(in, line)) {
+
+    if (file_.size() == 0) {
+        std::cerr << "[metadata] FAILED to read header\n";
+        return false;
+    }
+    const char* data = (const char*)file_.data();
+    const char* eol = (const char*)std::memchr(data, '\n', file_.size());
+    std::string header(data, eol ? (size_t)(eol - data) : file_.size());
+
+    // Resolve column indices once for every later fetch
+    auto cols = csv_row(header);
+    for (int i = 0; i < (int)cols.size(); i++) {
+        if (cols[i] == "url") cols_.url = i;
+        if (cols[i] == "publish_time") cols_.publish_time = i;
+        if (cols[i] == "authors") cols_.authors = i;
+        if (cols[i] == "title") cols_.title = i;
+        if (cols[i] == "abstract") cols_.abstract = i;
+    }
+
+    open_ = true;
+    return true;
+}
+
+// Copy one raw row out of the mapping at its stored byte position
+bool MetadataStore::read_row(const MetaInfo& meta_info, std::string& line) const {
+    // The last row may lack its trailing newline
+    uint64_t len = 0;
+    if (meta_info.file_offset < file_.size()) {
+        len = std::min<uint64_t>(meta_info.row_length, file_.size() - meta_info.file_offset);
+    }
+    ByteSpan bytes = file_.span(meta_info.file_offset, len);
+    if (bytes.empty()) {
         std::cerr << "[metadata] FAILED to read row at offset: "
                   << meta_info.file_offset << "\n";
-        return result;
+        return false;
     }
-    
-    // Parse the CSV row
+    line.assign((const char*)bytes.data, bytes.size);
+    if (line.back() == '\n') line.pop_back();
+    return true;
+}
+
+// Extract the served fields from a CSV row using the cached column indices
+MetaData MetadataStore::parse_row(const std::string& line) const {
+    MetaData result;
     auto r = csv_row(line);
-    
-    // Read header to get column indices (cache this in production for better performance)
-    in.seekg(0);
-    std::string header;
-    if (!std::getline(in, header)) {
-        std::cerr << "[metadata] FAILED to read header\n";
-        return result;
+
+    if (cols_.url >= 0 && (int)r.size() > cols_.url)
+        result.url = r[cols_.url];
+
+    if (cols_.publish_time >= 0 && (int)r.size() > cols_.publish_time)
+        result.publish_time = r[cols_.publish_time];
+
+    if (cols_.authors >= 0 && (int)r.size() > cols_.authors)
+        result.author = first_author_et_al(r[cols_.authors]);
+
+    if (cols_.title >= 0 && (int)r.size() > cols_.title)
+        result.title = r[cols_.title];
+
+    if (cols_.abstract >= 0 && (int)r.size() > cols_.abstract)
+        result.abstract = r[cols_.abstract];
+
+    return result;
+}
+
+// Fetch full metadata for one row using its stored byte position
+MetaData MetadataStore::fetch(const MetaInfo& meta_info) const {
+    std::string line;
+    if (!open_ || !read_row(meta_info, line)) return MetaData{};
+    return parse_row(line);
+}
+
+// Fetch many rows, copying them in file order so the page faults run forward
+std::vector<MetaData> MetadataStore::fetch_batch(const std::vector<const MetaInfo*>& rows) const {
+    std::vector<MetaData> result(rows.size());
+    if (!open_) return result;
+
+    std::vector<size_t> order;
+    order.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (rows[i]) order.push_back(i);
     }
-    
-    auto cols = csv_row(header);
-    int url_i = -1, pub_i = -1, auth_i = -1, title_i = -1, abstract_i = -1;
-    
-    for (int i = 0; i < (int)cols.size(); i++) {
-        if (cols[i] == "url") url_i = i;
-        if (cols[i] == "publish_time") pub_i = i;
-        if (cols[i] == "authors") auth_i = i;
-        if (cols[i] == "title") title_i = i;
-        if (cols[i] == "abstract") abstract_i = i;
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return rows[a]->file_offset < rows[b]->file_offset;
+    });
+
+    std::string line;
+    for (size_t i : order) {
+        if (read_row(*rows[i], line)) result[i] = parse_row(line);
     }
-    
-    // Extract fields
-    if (url_i >= 0 && (int)r.size() > url_i)
-        result.url = r[url_i];
-    
-    if (pub_i >= 0 && (int)r.size() > pub_i)
-        result.publish_time = r[pub_i];
-    
-    if (auth_i >= 0 && (int)r.size() > auth_i)
-        result.author = first_author_et_al(r[auth_i]);
-    
-    if (title_i >= 0 && (int)r.size() > title_i)
-        result.title = r[title_i];
-    
-    if (abstract_i >= 0 && (int)r.size() > abstract_i)
-        result.abstract = r[abstract_i];
-    
     return result;
 }
 
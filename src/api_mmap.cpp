@@ -0,0 +1,127 @@
+#include "api_mmap.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cord19 {
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        open_ = std::exchange(other.open_, false);
+#ifdef _WIN32
+        mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const fs::path& path, MapAccess access) {
+    close();
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(file, &len)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Empty files cannot be mapped; they are simply an empty span
+    if (len.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (!view) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            return false;
+        }
+        mapping_ = mapping;
+        data_ = (const uint8_t*)view;
+        size_ = (size_t)len.QuadPart;
+    }
+    CloseHandle(file);
+    open_ = true;
+    advise(access);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle((HANDLE)mapping_);
+    data_ = nullptr;
+    mapping_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
+
+// No readahead control on Windows mappings
+void MappedFile::advise(MapAccess) const {}
+
+#else
+
+bool MappedFile::open(const fs::path& path, MapAccess access) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files cannot be mapped; they are simply an empty span
+    if (st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        data_ = (const uint8_t*)p;
+        size_ = (size_t)st.st_size;
+    }
+    ::close(fd);
+    open_ = true;
+    advise(access);
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) munmap((void*)data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+    open_ = false;
+}
+
+void MappedFile::advise(MapAccess access) const {
+    if (!data_) return;
+    int advice = MADV_NORMAL;
+    switch (access) {
+        case MapAccess::Normal: advice = MADV_NORMAL; break;
+        case MapAccess::Random: advice = MADV_RANDOM; break;
+        case MapAccess::Sequential: advice = MADV_SEQUENTIAL; break;
+        case MapAccess::WillNeed: advice = MADV_WILLNEED; break;
+    }
+    madvise((void*)data_, size_, advice);
+}
+
+#endif
+
+} // namespace cord19
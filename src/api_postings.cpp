@@ -0,0 +1,226 @@
+#include "api_postings.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cord19 {
+
+PostingCursor::PostingCursor(const PostingSource& src)
+    : src_(src), remaining_(src.count) {
+    if (refill()) doc_ = docs_[0];
+}
+
+bool PostingCursor::refill(uint32_t target) {
+    pos_ = 0;
+    len_ = 0;
+    if (src_.postings.empty() || remaining_ == 0) return false;
+    return (src_.codec == POSTINGS_SVB) ? refill_svb(target) : refill_raw();
+}
+
+// Split the next chunk of raw (docId, tf) pairs out of the mapping
+bool PostingCursor::refill_raw() {
+    uint32_t n = std::min(remaining_, CHUNK);
+    uint64_t bytes = (uint64_t)n * sizeof(uint32_t) * 2;
+    if (next_offset_ + bytes > src_.postings.size) {
+        remaining_ = 0;
+        return false;
+    }
+
+    const uint8_t* p = src_.postings.data + next_offset_;
+    for (uint32_t i = 0; i < n; i++, p += sizeof(uint32_t) * 2) {
+        std::memcpy(&docs_[i], p, sizeof(uint32_t));
+        std::memcpy(&tfs_[i], p + sizeof(uint32_t), sizeof(uint32_t));
+    }
+
+    len_ = n;
+    remaining_ -= n;
+    next_offset_ += bytes;
+    return true;
+}
+
+// Decode the next compressed block, skipping blocks (by header only) whose
+// last docId is below target
+bool PostingCursor::refill_svb(uint32_t target) {
+    const ByteSpan& in = src_.postings;
+    uint32_t n = 0;
+    uint32_t prev_last = last_doc_;
+    uint32_t header[2];
+    const uint8_t* payload = nullptr;
+
+    while (true) {
+        n = std::min(remaining_, SVB_BLOCK);
+        if (next_offset_ + SVB_BLOCK_HEADER > in.size) {
+            remaining_ = 0;
+            return false;
+        }
+        std::memcpy(header, in.data + next_offset_, SVB_BLOCK_HEADER);
+        if (next_offset_ + SVB_BLOCK_HEADER + header[1] > in.size) {
+            remaining_ = 0;
+            return false;
+        }
+        payload = in.data + next_offset_ + SVB_BLOCK_HEADER;
+        next_offset_ += SVB_BLOCK_HEADER + header[1];
+        remaining_ -= n;
+        next_block_++;
+
+        // Whole block below target: skip it without decoding the payload
+        if (header[0] < target && remaining_ > 0) {
+            prev_last = header[0];
+            continue;
+        }
+        break;
+    }
+    last_doc_ = header[0];
+
+    // The SIMD decoder reads up to SVB_PADDING bytes past the payload; only a
+    // block at the very end of the barrel needs a padded copy
+    uint32_t payload_len = header[1];
+    if ((size_t)(src_.mapping_end - payload) < (size_t)payload_len + SVB_PADDING) {
+        if (payload_len > SVB_MAX_PAYLOAD) {
+            remaining_ = 0;
+            return false;
+        }
+        std::memcpy(block_.data(), payload, payload_len);
+        std::memset(block_.data() + payload_len, 0, SVB_PADDING);
+        payload = block_.data();
+    }
+
+    if (!svb_decode_block(payload, payload_len, n, prev_last, docs_.data(), tfs_.data())) {
+        remaining_ = 0;
+        return false;
+    }
+    len_ = n;
+    return true;
+}
+
+// Step to the next posting, refilling when the chunk is used up
+void PostingCursor::next() {
+    if (doc_ == END_DOC) return;
+    if (++pos_ >= len_ && !refill()) {
+        doc_ = END_DOC;
+        return;
+    }
+    doc_ = docs_[pos_];
+}
+
+// Position the reader at the start of `block` (next refill decodes it)
+void PostingCursor::seek_block(uint32_t block) {
+    next_block_ = block;
+    next_offset_ = src_.skips[block].offset;
+    remaining_ = src_.count - block * SVB_BLOCK;
+    last_doc_ = (block == 0) ? 0 : src_.skips[block - 1].last_doc;
+}
+
+const SvbSkip* PostingCursor::block_for(uint32_t target) {
+    if (!src_.skips) return nullptr;
+
+    // Blocks before the one currently decoded cannot hold target
+    const SvbSkip* end = src_.skips + svb_block_count(src_.count);
+    const SvbSkip* from = src_.skips + ((next_block_ > 0) ? next_block_ - 1 : 0);
+    const SvbSkip* it = std::lower_bound(from, end, target,
+                                         [](const SvbSkip& s, uint32_t t) { return s.last_doc < t; });
+    return (it == end) ? nullptr : it;
+}
+
+// Skip forward to the first posting with docId >= target
+void PostingCursor::advance(uint32_t target) {
+    if (doc_ >= target) return;
+
+    // Jump straight to the target block via the skip list
+    if (docs_[len_ - 1] < target && src_.skips) {
+        const SvbSkip* b = block_for(target);
+        if (!b) {
+            doc_ = END_DOC;
+            return;
+        }
+        seek_block((uint32_t)(b - src_.skips));
+        if (!refill()) {
+            doc_ = END_DOC;
+            return;
+        }
+    }
+
+    // Skip whole chunks whose last docId is still below target
+    while (docs_[len_ - 1] < target) {
+        if (!refill(target)) {
+            doc_ = END_DOC;
+            return;
+        }
+    }
+
+    // Binary search inside the current chunk
+    uint32_t lo = pos_, hi = len_ - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (docs_[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    pos_ = lo;
+    doc_ = docs_[pos_];
+}
+
+PostingSource posting_source(const Segment& seg, const LexEntry& e) {
+    const ByteSpan& file = seg.use_barrels ? seg.inv_barrels[e.barrelId] : seg.inv;
+    PostingSource src;
+    src.codec = seg.use_barrels ? seg.barrel_params.codec : POSTINGS_RAW;
+    src.count = e.count;
+
+    uint64_t bytes = (src.codec == POSTINGS_SVB) ? e.bytes
+                                                 : (uint64_t)e.count * sizeof(uint32_t) * 2;
+    src.postings = file.sub(e.offset, bytes);
+    src.mapping_end = file.data + file.size;
+
+    if (seg.has_skips) {
+        // Skip files are 16-byte records in an aligned section or mapping
+        ByteSpan sk = seg.skip_barrels[e.barrelId].sub(
+            e.skip_offset, (uint64_t)svb_block_count(e.count) * sizeof(SvbSkip));
+        if (!sk.empty()) src.skips = reinterpret_cast<const SvbSkip*>(sk.data);
+    }
+    return src;
+}
+
+bool read_positions(const Segment& seg, const LexEntry& e, uint64_t slot,
+                    uint32_t n, std::vector<uint32_t>& out) {
+    out.resize(n);
+    if (!seg.has_positions || n == 0) return n == 0;
+
+    ByteSpan p = seg.pos_barrels[e.barrelId].sub(e.pos_offset + slot * sizeof(uint32_t),
+                                                  (uint64_t)n * sizeof(uint32_t));
+    if (p.empty()) return false;
+    std::memcpy(out.data(), p.data, p.size);
+    return true;
+}
+
+bool read_impact_groups(const Segment& seg, const LexEntry& e, std::vector<ImpactGroup>& out) {
+    out.clear();
+    if (!seg.has_impacts) return false;
+    const ByteSpan& file = seg.impact_barrels[e.barrelId];
+
+    // Groups must end before the barrel's tail padding
+    if (file.size < SVB_PADDING || e.impact_offset > file.size - SVB_PADDING) return false;
+    ByteReader in(file.sub(e.impact_offset, file.size - SVB_PADDING - e.impact_offset));
+
+    uint32_t ngroups = in.u32();
+    for (uint32_t i = 0; i < ngroups && in.ok(); i++) {
+        ImpactGroup g;
+        g.impact = in.u32();
+        g.count = in.u32();
+        g.docs = in.bytes(in.u32());
+        out.push_back(g);
+    }
+    return in.ok();
+}
+
+bool decode_impact_docs(const ImpactGroup& g, std::vector<uint32_t>& out) {
+    out.resize(g.count);
+    uint32_t ctrl_len = (g.count + 3) / 4;
+    if (g.docs.size < ctrl_len) return false;
+
+    // Groups can be long, so check the size before decoding rather than after
+    if (svb_data_len(g.docs.data, g.count) != g.docs.size - ctrl_len) return false;
+    svb_decode(g.docs.data, g.docs.data + ctrl_len, g.count, out.data());
+    svb_prefix_sum(out.data(), g.count, 0);
+    return true;
+}
+
+} // namespace cord19
@@ -0,0 +1,166 @@
+#include "api_query.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+#include "api_postings.hpp"
+#include "textutil.hpp"
+
+namespace cord19 {
+
+// Tokenize text and keep the terms the indexer keeps
+static void append_terms(const std::string& text, std::vector<std::string>& out) {
+    for (auto& t : tokenize(text)) {
+        if (t.size() < 2) continue;
+        if (is_stopword(t)) continue;
+        out.push_back(t);
+    }
+}
+
+ParsedQuery parse_query(const std::string& query) {
+    ParsedQuery pq;
+    size_t i = 0;
+
+    while (i < query.size()) {
+        size_t open = query.find('"', i);
+
+        // Plain text up to the next quote (or the end)
+        size_t plain_end = (open == std::string::npos) ? query.size() : open;
+        append_terms(query.substr(i, plain_end - i), pq.terms);
+        if (open == std::string::npos) break;
+
+        // An unterminated quote is treated as plain text
+        size_t close = query.find('"', open + 1);
+        if (close == std::string::npos) {
+            append_terms(query.substr(open + 1), pq.terms);
+            break;
+        }
+
+        PhraseClause pc;
+        append_terms(query.substr(open + 1, close - open - 1), pc.terms);
+        i = close + 1;
+
+        // Optional proximity window right after the closing quote
+        if (i < query.size() && query[i] == '~') {
+            size_t j = i + 1;
+            uint32_t slop = 0;
+            while (j < query.size() && std::isdigit((unsigned char)query[j])) {
+                slop = std::min<uint32_t>(slop * 10 + (uint32_t)(query[j] - '0'), MAX_PHRASE_SLOP);
+                j++;
+            }
+            if (j > i + 1) {
+                pc.slop = slop;
+                i = j;
+            }
+        }
+
+        pq.terms.insert(pq.terms.end(), pc.terms.begin(), pc.terms.end());
+
+        // A single kept term is just a normal term
+        if (pc.terms.size() >= 2) pq.phrases.push_back(std::move(pc));
+    }
+    return pq;
+}
+
+// True if the lists hold p0 < p1 < ... < pn-1 with pn-1 - p0 <= (n-1) + slop.
+// For each start, taking the earliest later position for every following term
+// gives the tightest window, so one greedy pass per start is enough.
+static bool positions_match(const std::vector<std::vector<uint32_t>>& pos, uint32_t slop) {
+    const uint64_t max_span = (uint64_t)(pos.size() - 1) + slop;
+
+    for (uint32_t p0 : pos[0]) {
+        uint32_t prev = p0;
+        for (size_t i = 1; i < pos.size(); i++) {
+            auto it = std::upper_bound(pos[i].begin(), pos[i].end(), prev);
+
+            // No later occurrence here means no later start can match either
+            if (it == pos[i].end()) return false;
+            prev = *it;
+        }
+        if ((uint64_t)(prev - p0) <= max_span) return true;
+    }
+    return false;
+}
+
+// Docs matching one phrase clause, by position-list intersection
+static std::vector<uint32_t> match_phrase(const Segment& seg, const PhraseClause& pc,
+                                          const LexEntry* const* ents) {
+    std::vector<uint32_t> out;
+
+    // Every phrase term must exist in this segment
+    for (size_t i = 0; i < pc.terms.size(); i++) {
+        if (!ents[i] || ents[i]->df == 0) return out;
+    }
+
+    // Cursors step one posting at a time so `slot` (sum of tf over earlier
+    // postings) stays exact; it locates the doc's positions in the term block
+    struct PhraseCursor {
+        PostingCursor cur;
+        uint64_t slot = 0;
+    };
+    std::vector<PhraseCursor> cs;
+    cs.reserve(pc.terms.size());
+    for (size_t i = 0; i < pc.terms.size(); i++) {
+        const LexEntry* e = ents[i];
+        cs.push_back(PhraseCursor{PostingCursor(posting_source(seg, *e))});
+    }
+
+    std::vector<std::vector<uint32_t>> pos(pc.terms.size());
+    uint32_t target = cs[0].cur.doc();
+
+    while (target != END_DOC) {
+        // Bring every cursor to target; restart when one overshoots
+        bool aligned = true;
+        for (auto& c : cs) {
+            while (c.cur.doc() < target) {
+                c.slot += c.cur.tf();
+                c.cur.next();
+            }
+            if (c.cur.doc() == END_DOC) return out;
+            if (c.cur.doc() > target) {
+                target = c.cur.doc();
+                aligned = false;
+                break;
+            }
+        }
+        if (!aligned) continue;
+
+        // All terms occur in target: check their positions
+        bool ok = true;
+        if (seg.has_positions) {
+            for (size_t i = 0; i < cs.size() && ok; i++) {
+                ok = read_positions(seg, *ents[i], cs[i].slot, cs[i].cur.tf(), pos[i]);
+            }
+            ok = ok && positions_match(pos, pc.slop);
+        }
+        if (ok) out.push_back(target);
+
+        target++;
+    }
+    return out;
+}
+
+std::vector<uint32_t> match_phrases(const Segment& seg,
+                                    const std::vector<PhraseClause>& phrases,
+                                    const std::vector<const LexEntry*>& ents) {
+    std::vector<uint32_t> result;
+    size_t first_term = 0;
+    for (size_t i = 0; i < phrases.size(); i++) {
+        if (first_term + phrases[i].terms.size() > ents.size()) return {};
+        auto docs = match_phrase(seg, phrases[i], ents.data() + first_term);
+        first_term += phrases[i].terms.size();
+        if (i == 0) {
+            result = std::move(docs);
+        } else {
+            std::vector<uint32_t> both;
+            std::set_intersection(result.begin(), result.end(),
+                                  docs.begin(), docs.end(), std::back_inserter(both));
+            result = std::move(both);
+        }
+        if (result.empty()) break;
+    }
+    return result;
+}
+
+} // namespace cord19
@@ -0,0 +1,188 @@
+#include "api_ram_segment.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+#include "api_segment.hpp"
+#include "lexicon_dict.hpp"
+#include "textutil.hpp"
+
+namespace cord19 {
+
+RamDoc make_ram_doc(const std::string& cord_uid, const std::string& title,
+                    const std::string& json_relpath, const std::string& text) {
+    std::unordered_map<std::string, std::vector<uint32_t>> tpos;
+    uint32_t doc_len = 0;
+    for (auto& t : tokenize(text)) {
+        if (t.size() < 2) continue;
+        if (is_stopword(t)) continue;
+        tpos[t].push_back(doc_len);
+        doc_len += 1;
+    }
+
+    RamDoc doc;
+    doc.meta = DocMeta{cord_uid, title, json_relpath, doc_len};
+    doc.terms.reserve(tpos.size());
+    for (auto& kv : tpos) doc.terms.emplace_back(kv.first, std::move(kv.second));
+    std::sort(doc.terms.begin(), doc.terms.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+    return doc;
+}
+
+void build_ram_segment(const std::vector<RamDoc>& docs, size_t first, size_t count, Segment& s) {
+    s = Segment{};
+
+    // Doc columns (docId = index in the run)
+    s.doc_lens.reserve(count);
+    s.uid_offsets.reserve(count + 1);
+    for (size_t i = 0; i < count; i++) {
+        const DocMeta& m = docs[first + i].meta;
+        s.uid_offsets.push_back((uint32_t)s.uid_pool.size());
+        s.uid_pool += m.cord_uid;
+        s.doc_lens.push_back(m.doc_len);
+        s.total_len += m.doc_len;
+    }
+    s.uid_offsets.push_back((uint32_t)s.uid_pool.size());
+    build_uid_order(s);
+    s.N = (uint32_t)count;
+    s.avgdl = count ? (float)((double)s.total_len / (double)count) : 0.0f;
+
+    // Postings of each term in docId order
+    struct Occurrence {
+        uint32_t docId;
+        const std::vector<uint32_t>* positions;
+    };
+    std::unordered_map<std::string_view, std::vector<Occurrence>> postings;
+    for (size_t i = 0; i < count; i++) {
+        for (const auto& [term, plist] : docs[first + i].terms) {
+            postings[term].push_back(Occurrence{(uint32_t)i, &plist});
+        }
+    }
+    std::vector<std::string_view> terms;
+    terms.reserve(postings.size());
+    for (const auto& kv : postings) terms.push_back(kv.first);
+    std::sort(terms.begin(), terms.end());
+
+    // Raw (docId, tf) pairs and position lists, with the bounds WAND needs
+    s.lex.map.reserve(terms.size() * 2 + 1);
+    std::vector<DictTerm> sorted;
+    sorted.reserve(terms.size());
+    for (uint32_t tid = 0; tid < (uint32_t)terms.size(); tid++) {
+        const auto& occ = postings[terms[tid]];
+        LexEntry e;
+        e.termId = tid;
+        e.df = (uint32_t)occ.size();
+        e.count = e.df;
+        e.offset = (uint64_t)s.ram_postings.size() * sizeof(uint32_t);
+        e.pos_offset = (uint64_t)s.ram_positions.size() * sizeof(uint32_t);
+        e.min_dl = UINT32_MAX;
+        for (const auto& o : occ) {
+            uint32_t tf = (uint32_t)o.positions->size();
+            s.ram_postings.push_back(o.docId);
+            s.ram_postings.push_back(tf);
+            s.ram_positions.insert(s.ram_positions.end(), o.positions->begin(), o.positions->end());
+            e.max_tf = std::max(e.max_tf, tf);
+            e.min_dl = std::min(e.min_dl, s.doc_lens[o.docId]);
+        }
+        auto it = s.lex.map.emplace(std::string(terms[tid]), e).first;
+        sorted.push_back(DictTerm{it->first, tid, e.df});
+    }
+
+    s.use_barrels = false;
+    s.inv = ByteSpan{(const uint8_t*)s.ram_postings.data(), s.ram_postings.size() * sizeof(uint32_t)};
+    s.pos_barrels = {ByteSpan{(const uint8_t*)s.ram_positions.data(), s.ram_positions.size() * sizeof(uint32_t)}};
+    s.has_bounds = true;
+    s.has_positions = true;
+
+    std::string err;
+    std::vector<uint8_t> bytes;
+    if (!encode_term_dictionary(sorted, bytes, err) || !s.dict.adopt(std::move(bytes), err)) {
+        std::cerr << "[ram] " << err << "\n";
+    }
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(terms.size());
+    for (auto term : terms) hashes.push_back(bloom_term_hash(term));
+    encode_term_filter(hashes, bytes);
+    if (!s.filter.adopt(std::move(bytes), err)) {
+        std::cerr << "[ram] " << err << "\n";
+    }
+}
+
+// Bytes a buffered doc holds (terms, positions and the doc fields)
+static uint64_t ram_doc_bytes(const RamDoc& doc) {
+    uint64_t n = sizeof(RamDoc) + doc.meta.cord_uid.size() + doc.meta.title.size() + doc.meta.json_relpath.size();
+    for (const auto& [term, plist] : doc.terms) {
+        n += sizeof(doc.terms[0]) + term.size() + plist.size() * sizeof(uint32_t);
+    }
+    return n;
+}
+
+void RamBuffer::add(RamDoc doc) {
+    if (docs_.empty()) first_added_ = std::chrono::steady_clock::now();
+    bytes_ += ram_doc_bytes(doc);
+    by_uid_[doc.meta.cord_uid].push_back(docs_.size());
+    docs_.push_back(std::move(doc));
+    deleted_.push_back(0);
+
+    auto seg = std::make_shared<Segment>();
+    build_ram_segment(docs_, docs_.size() - 1, 1, *seg);
+    runs_.push_back(Run{docs_.size() - 1, 1, std::move(seg)});
+
+    // Fold the newest run into its predecessor while that one is no larger
+    while (runs_.size() >= 2 && runs_[runs_.size() - 2].count <= runs_.back().count) {
+        Run& prev = runs_[runs_.size() - 2];
+        prev.count += runs_.back().count;
+        runs_.pop_back();
+        auto merged = std::make_shared<Segment>();
+        build_ram_segment(docs_, prev.first, prev.count, *merged);
+        prev.seg = std::move(merged);
+    }
+}
+
+size_t RamBuffer::remove(std::string_view cord_uid) {
+    auto it = by_uid_.find(std::string(cord_uid));
+    if (it == by_uid_.end()) return 0;
+    size_t removed = 0;
+    for (size_t i : it->second) {
+        if (deleted_[i]) continue;
+        deleted_[i] = 1;
+        deleted_count_++;
+        removed++;
+    }
+    return removed;
+}
+
+bool RamBuffer::flush_due(const RamFlushPolicy& policy) const {
+    if (docs_.empty()) return false;
+    if (policy.max_docs && docs_.size() >= policy.max_docs) return true;
+    if (policy.max_bytes && bytes_ >= policy.max_bytes) return true;
+    return policy.max_age.count() > 0 &&
+           std::chrono::steady_clock::now() - first_added_ >= policy.max_age;
+}
+
+std::shared_ptr<const LiveDocs> RamBuffer::live_range(size_t first, size_t count) const {
+    if (deleted_count_ == 0) return nullptr;
+    auto live = std::make_shared<LiveDocs>();
+    live->reset((uint32_t)count);
+    for (size_t i = 0; i < count; i++) {
+        if (deleted_[first + i]) live->remove((uint32_t)i);
+    }
+    if (live->deleted == 0) return nullptr;
+    return live;
+}
+
+std::shared_ptr<const LiveDocs> RamBuffer::run_live(const Run& run) const {
+    return live_range(run.first, run.count);
+}
+
+std::shared_ptr<const LiveDocs> RamBuffer::live_docs() const {
+    return live_range(0, docs_.size());
+}
+
+void RamBuffer::fill_writer(SegmentWriter& w) const {
+    for (const auto& doc : docs_) w.add_document(doc.meta, doc.terms);
+}
+
+} // namespace cord19
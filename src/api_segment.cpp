@@ -1,12 +1,16 @@
 #include "api_segment.hpp"
 
 #include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
+#include "barrel_writer.hpp"
 #include "indexio.hpp"
+#include "live_docs.hpp"
+#include "segment_file.hpp"
 
 namespace cord19 {
 
@@ -25,13 +29,39 @@ std::vector<std::string> load_manifest(const fs::path& manifest_path) {
     return segs;
 }
 
-// Save segment list to manifest.bin
-void save_manifest(const fs::path& manifest_path, const std::vector<std::string>& segs) {
-    std::ofstream out(manifest_path, std::ios::binary);
-    write_u32(out, (uint32_t)segs.size());
+// Save segment list to manifest.bin. The list is written to a temp file and
+// renamed over the old one, so readers see either the old or the new list.
+bool save_manifest(const fs::path& manifest_path, const std::vector<std::string>& segs) {
+    fs::path tmp = manifest_path;
+    tmp += ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary);
+        write_u32(out, (uint32_t)segs.size());
+
+        // Write all segment names
+        for (auto& s : segs) write_string(out, s);
+        if (!out) return false;
+    }
+    std::error_code ec;
+    fs::rename(tmp, manifest_path, ec);
+    return !ec;
+}
 
-    // Write all segment names
-    for (auto& s : segs) write_string(out, s);
+// Segments of an index: manifest.bin, or every seg_* folder if it is missing/empty
+std::vector<std::string> list_segments(const fs::path& index_dir) {
+    std::vector<std::string> segs = load_manifest(index_dir / "manifest.bin");
+    if (!segs.empty()) return segs;
+
+    fs::path segroot = index_dir / "segments";
+    if (fs::exists(segroot) && fs::is_directory(segroot)) {
+        for (auto& e : fs::directory_iterator(segroot)) {
+            if (!e.is_directory()) continue;
+            auto name = e.path().filename().string();
+            if (name.rfind("seg_", 0) == 0) segs.push_back(name);
+        }
+        std::sort(segs.begin(), segs.end());
+    }
+    return segs;
 }
 
 // Create a zero-padded segment folder name
@@ -41,166 +71,529 @@ std::string seg_name(uint32_t id) {
     return ss.str();
 }
 
+// Number of a seg_NNNNNN name (0 if it has none)
+static uint32_t seg_number(const std::string& name) {
+    if (name.rfind("seg_", 0) != 0) return 0;
+    return (uint32_t)std::strtoul(name.c_str() + 4, nullptr, 10);
+}
+
+// First segment number not used by the manifest or any folder
+std::string next_segment_name(const fs::path& index_dir) {
+    uint32_t max_id = 0;
+    for (const auto& n : list_segments(index_dir)) max_id = std::max(max_id, seg_number(n));
+    fs::path segroot = index_dir / "segments";
+    std::error_code ec;
+    if (fs::exists(segroot, ec)) {
+        for (auto& e : fs::directory_iterator(segroot, ec)) {
+            max_id = std::max(max_id, seg_number(e.path().filename().string()));
+        }
+    }
+    return seg_name(max_id + 1);
+}
+
+std::mutex& manifest_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+// Name of a segment file (section name inside segment.seg)
+static std::string seg_file(const fs::path& p) {
+    return p.filename().string();
+}
+
 // Load segment using legacy (single inverted.bin + lexicon.bin) format
-static bool load_segment_legacy(const fs::path& segdir, Segment& s) {
-    std::ifstream in(segdir / "lexicon.bin", std::ios::binary);
-    if (!in) return false;
+static bool load_segment_legacy(Segment& s) {
+    ByteSpan lex;
+    if (!s.store.get("lexicon.bin", lex, MapAccess::Sequential)) return false;
+    ByteReader in(lex);
 
-    uint32_t tcount = read_u32(in);
-    s.lex.reserve(tcount * 2 + 1);
+    uint32_t tcount = in.u32();
+    s.lex.map.reserve(tcount * 2 + 1);
 
     // Read lexicon entries
-    for (uint32_t i = 0; i < tcount; i++) {
-        std::string term = read_string(in);
+    for (uint32_t i = 0; i < tcount && in.ok(); i++) {
+        std::string term = in.str();
         LexEntry e;
-        e.termId = read_u32(in);
-        e.df = read_u32(in);
-        e.offset = read_u64(in);
-        e.count = read_u32(in);
-        s.lex.emplace(std::move(term), e);
+        e.termId = in.u32();
+        e.df = in.u32();
+        e.offset = in.u64();
+        e.count = in.u32();
+        s.lex.map.emplace(std::move(term), e);
     }
+    s.store.release("lexicon.bin");
+    if (!in.ok()) return false;
 
-    // Open legacy inverted file stream
-    s.inv.open(segdir / "inverted.bin", std::ios::binary);
+    // Map legacy inverted file
     s.use_barrels = false;
-    return (bool)s.inv;
+    return s.store.get("inverted.bin", s.inv, MapAccess::Random);
 }
 
 // Load segment using barrelized inverted index format
-static bool load_segment_barrels(const fs::path& segdir, Segment& s) {
+static bool load_segment_barrels(const fs::path& segdir, Segment& s, ThreadPool* pool) {
     s.use_barrels = true;
-    if (!read_barrels_manifest(segdir, s.barrel_params)) return false;
 
-    // Open all inverted barrel files
+    // barrels.bin: count, terms per barrel, [codec], [first termId per barrel]
+    ByteSpan manifest;
+    if (!s.store.get(seg_file(barrels_manifest_path(segdir)), manifest)) return false;
+    if (!parse_barrels_manifest(manifest.data, manifest.size, s.barrel_params)) return false;
+    if (s.barrel_params.codec != POSTINGS_RAW && s.barrel_params.codec != POSTINGS_SVB) {
+        std::cerr << "[segment] unknown postings codec " << s.barrel_params.codec
+                  << " in: " << segdir << "\n";
+        return false;
+    }
+
+    // Map all inverted barrel files
     s.inv_barrels.resize(s.barrel_params.barrel_count);
     for (uint32_t b = 0; b < s.barrel_params.barrel_count; b++) {
-        s.inv_barrels[b].open(inv_barrel_path(segdir, b), std::ios::binary);
-        if (!s.inv_barrels[b]) return false;
+        if (!s.store.get(seg_file(inv_barrel_path(segdir, b)), s.inv_barrels[b], MapAccess::Random))
+            return false;
     }
 
-    // Load lexicon from all lex barrels
-    s.lex.clear();
-    for (uint32_t b = 0; b < s.barrel_params.barrel_count; b++) {
-        std::ifstream in(lex_barrel_path(segdir, b), std::ios::binary);
-        if (!in) return false;
+    // Hashed lexicon: entries are used in place, nothing to parse
+    std::string mph_name = seg_file(mph_lexicon_path(segdir));
+    if (s.store.has(mph_name)) {
+        ByteSpan mph;
+        std::string err = "cannot map " + mph_name;
+        if (!s.store.get(mph_name, mph, MapAccess::Random) || !s.lex.open(mph, err)) {
+            std::cerr << "[segment] " << err << " in: " << segdir << "\n";
+            return false;
+        }
+        return true;
+    }
+
+    // Older segments: load lexicon from all lex barrels. The files are mapped
+    // here (the store is single-threaded), parsed into per-barrel shards on
+    // the pool, then merged; terms point into the mapped files until then.
+    const uint32_t nbarrels = s.barrel_params.barrel_count;
+    std::vector<ByteSpan> lex_files(nbarrels);
+    for (uint32_t b = 0; b < nbarrels; b++) {
+        if (!s.store.get(seg_file(lex_barrel_path(segdir, b)), lex_files[b], MapAccess::Sequential)) return false;
+    }
 
-        uint32_t tcount = read_u32(in);
+    std::vector<std::vector<std::pair<std::string_view, LexEntry>>> shards(nbarrels);
+    std::vector<char> parsed(nbarrels, 0);
+    const bool sized = s.barrel_params.codec != POSTINGS_RAW;
+    parallel_for(pool, nbarrels, [&](size_t b) {
+        ByteReader in(lex_files[b]);
+        uint32_t tcount = in.u32();
+        if (!in.ok() || tcount > in.remaining()) return;
+        auto& shard = shards[b];
+        shard.reserve(tcount);
 
         // Read lexicon entries for this barrel
-        for (uint32_t i = 0; i < tcount; i++) {
-            std::string term = read_string(in);
+        for (uint32_t i = 0; i < tcount && in.ok(); i++) {
+            ByteSpan term = in.bytes(in.u32());
             LexEntry e;
-            e.termId = read_u32(in);
-            e.df = read_u32(in);
-            e.offset = read_u64(in);
-            e.count = read_u32(in);
-            e.barrelId = b;
-            s.lex.emplace(std::move(term), e);
+            e.termId = in.u32();
+            e.df = in.u32();
+            e.offset = in.u64();
+            e.count = in.u32();
+            if (sized) e.bytes = in.u32();
+            e.barrelId = (uint32_t)b;
+            shard.emplace_back(std::string_view((const char*)term.data, term.size), e);
         }
+        parsed[b] = in.ok();
+    });
+
+    s.lex.map.clear();
+    size_t total = 0;
+    for (uint32_t b = 0; b < nbarrels; b++) {
+        if (!parsed[b]) return false;
+        total += shards[b].size();
+    }
+    s.lex.map.reserve(total);
+    for (const auto& shard : shards) {
+        for (const auto& [term, e] : shard) s.lex.map.emplace(std::string(term), e);
     }
+    for (uint32_t b = 0; b < nbarrels; b++) s.store.release(seg_file(lex_barrel_path(segdir, b)));
     return true;
 }
 
+// Attach per-term (max_tf, min_dl) from bounds.bin to lexicon entries
+static void load_term_bounds(const fs::path& segdir, Segment& s) {
+    // Hashed lexicon entries are written with their bounds
+    if (s.lex.mapped()) {
+        s.has_bounds = true;
+        return;
+    }
+
+    ByteSpan bytes;
+    if (!s.store.get(seg_file(term_bounds_path(segdir)), bytes, MapAccess::Sequential)) return;
+    ByteReader in(bytes);
+
+    uint32_t tcount = in.u32();
+    if (!in.ok() || (uint64_t)tcount * 2 * sizeof(uint32_t) > in.remaining()) return;
+    std::vector<std::pair<uint32_t, uint32_t>> bounds(tcount);
+    for (uint32_t i = 0; i < tcount; i++) {
+        bounds[i].first = in.u32();
+        bounds[i].second = in.u32();
+    }
+    s.store.release(seg_file(term_bounds_path(segdir)));
+
+    // Copy bounds into lexicon entries by termId
+    for (auto& kv : s.lex.map) {
+        LexEntry& e = kv.second;
+        if (e.termId >= tcount) return;
+        e.max_tf = bounds[e.termId].first;
+        e.min_dl = bounds[e.termId].second;
+    }
+    s.has_bounds = true;
+}
+
+// Map skip barrels and place each term's skip list. Entries are written in
+// postings order, so a term's list starts after those of the terms stored
+// before it in the same barrel.
+static void load_term_skips(const fs::path& segdir, Segment& s) {
+    if (!s.use_barrels || s.barrel_params.codec != POSTINGS_SVB) return;
+
+    s.skip_barrels.resize(s.barrel_params.barrel_count);
+    for (uint32_t b = 0; b < s.barrel_params.barrel_count; b++) {
+        if (!s.store.get(seg_file(skip_barrel_path(segdir, b)), s.skip_barrels[b], MapAccess::WillNeed)) {
+            s.skip_barrels.clear();
+            return;
+        }
+    }
+
+    // Hashed lexicon entries are written with their skip offsets
+    if (s.lex.mapped()) {
+        s.has_skips = true;
+        return;
+    }
+
+    std::vector<std::vector<LexEntry*>> by_barrel(s.barrel_params.barrel_count);
+    for (auto& kv : s.lex.map) by_barrel[kv.second.barrelId].push_back(&kv.second);
+
+    for (auto& entries : by_barrel) {
+        std::sort(entries.begin(), entries.end(),
+                  [](const LexEntry* a, const LexEntry* b) { return a->offset < b->offset; });
+        uint64_t at = 0;
+        for (LexEntry* e : entries) {
+            e->skip_offset = at;
+            at += (uint64_t)svb_block_count(e->count) * sizeof(SvbSkip);
+        }
+
+        // A short skip file would let cursors read past the mapping
+        if (!entries.empty() && at > s.skip_barrels[entries[0]->barrelId].size) {
+            s.skip_barrels.clear();
+            return;
+        }
+    }
+    s.has_skips = true;
+}
+
+// Attach per-term position offsets and map positions barrels if present
+static void load_term_positions(const fs::path& segdir, Segment& s) {
+    if (!s.use_barrels) return;
+    std::string index_name = seg_file(pos_index_path(segdir));
+    if (!s.store.has(index_name)) return;
+
+    // Hashed lexicon entries already hold their offsets
+    std::vector<uint64_t> offsets;
+    if (!s.lex.mapped()) {
+        ByteSpan index;
+        if (!s.store.get(index_name, index, MapAccess::Sequential)) return;
+        ByteReader in(index);
+
+        uint32_t tcount = in.u32();
+        if (!in.ok() || (uint64_t)tcount * sizeof(uint64_t) > in.remaining()) return;
+        offsets.resize(tcount);
+        for (uint32_t i = 0; i < tcount; i++) offsets[i] = in.u64();
+        s.store.release(index_name);
+    }
+
+    s.pos_barrels.resize(s.barrel_params.barrel_count);
+    for (uint32_t b = 0; b < s.barrel_params.barrel_count; b++) {
+        if (!s.store.get(seg_file(pos_barrel_path(segdir, b)), s.pos_barrels[b], MapAccess::Random)) {
+            s.pos_barrels.clear();
+            return;
+        }
+    }
+
+    // Copy offsets into lexicon entries by termId
+    for (auto& kv : s.lex.map) {
+        LexEntry& e = kv.second;
+        if (e.termId >= offsets.size()) {
+            s.pos_barrels.clear();
+            return;
+        }
+        e.pos_offset = offsets[e.termId];
+    }
+    s.has_positions = true;
+}
+
+// Attach per-term impact offsets and map impact barrels if present.
+// Impacts quantize BM25 with fixed k1/b, so files built with other
+// parameters are ignored rather than scored inconsistently.
+static void load_term_impacts(const fs::path& segdir, Segment& s) {
+    if (!s.use_barrels) return;
+    ByteSpan index;
+    if (!s.store.get(seg_file(impact_index_path(segdir)), index, MapAccess::Sequential)) return;
+    ByteReader in(index);
+
+    uint32_t tcount = in.u32();
+    float k1 = in.f32();
+    float b = in.f32();
+    in.f32();  // avgdl the impacts were quantized with
+    if (!in.ok()) return;
+    if (k1 != BM25_K1 || b != BM25_B) {
+        std::cerr << "[segment] impacts built with k1=" << k1 << " b=" << b
+                  << ", ignoring them in: " << segdir << "\n";
+        return;
+    }
+
+    // Hashed lexicon entries already hold their offsets
+    std::vector<uint64_t> offsets;
+    if (!s.lex.mapped()) {
+        if ((uint64_t)tcount * sizeof(uint64_t) > in.remaining()) return;
+        offsets.resize(tcount);
+        for (uint32_t i = 0; i < tcount; i++) offsets[i] = in.u64();
+    }
+    s.store.release(seg_file(impact_index_path(segdir)));
+
+    s.impact_barrels.resize(s.barrel_params.barrel_count);
+    for (uint32_t i = 0; i < s.barrel_params.barrel_count; i++) {
+        if (!s.store.get(seg_file(impact_barrel_path(segdir, i)), s.impact_barrels[i], MapAccess::Random)) {
+            s.impact_barrels.clear();
+            return;
+        }
+    }
+
+    // Copy offsets into lexicon entries by termId
+    for (auto& kv : s.lex.map) {
+        LexEntry& e = kv.second;
+        if (e.termId >= offsets.size()) {
+            s.impact_barrels.clear();
+            return;
+        }
+        e.impact_offset = offsets[e.termId];
+    }
+    s.has_impacts = true;
+}
+
+// Open the sorted term dictionary; segments without a usable lexicon.dict
+// get one encoded from their lexicon
+static void load_term_dictionary(const fs::path& segdir, Segment& s) {
+    std::string name = seg_file(dict_lexicon_path(segdir));
+    std::string err;
+    if (s.store.has(name)) {
+        ByteSpan bytes;
+        err = "cannot map " + name;
+        if (s.store.get(name, bytes, MapAccess::Random) && s.dict.open(bytes, err)) return;
+        std::cerr << "[segment] " << err << ", rebuilding it in: " << segdir << "\n";
+    }
+
+    std::vector<DictTerm> sorted;
+    s.lex.for_each([&](std::string_view term, const LexEntry& e) {
+        if (e.df > 0) sorted.push_back(DictTerm{term, e.termId, e.df});
+    });
+    std::sort(sorted.begin(), sorted.end(),
+              [](const DictTerm& a, const DictTerm& b) { return a.term < b.term; });
+
+    std::vector<uint8_t> bytes;
+    if (!encode_term_dictionary(sorted, bytes, err) || !s.dict.adopt(std::move(bytes), err)) {
+        std::cerr << "[segment] " << err << " in: " << segdir << "\n";
+    }
+}
+
+// Open the term filter; segments without a usable lexicon.bloom get one
+// built from their lexicon
+static void load_term_filter(const fs::path& segdir, Segment& s) {
+    std::string name = seg_file(bloom_lexicon_path(segdir));
+    std::string err;
+    if (s.store.has(name)) {
+        ByteSpan bytes;
+        err = "cannot map " + name;
+        if (s.store.get(name, bytes, MapAccess::Random) && s.filter.open(bytes, err)) return;
+        std::cerr << "[segment] " << err << ", rebuilding it in: " << segdir << "\n";
+    }
+
+    std::vector<uint64_t> hashes;
+    s.lex.for_each([&](std::string_view term, const LexEntry& e) {
+        if (e.df > 0) hashes.push_back(bloom_term_hash(term));
+    });
+
+    std::vector<uint8_t> bytes;
+    encode_term_filter(hashes, bytes);
+    if (!s.filter.adopt(std::move(bytes), err)) {
+        std::cerr << "[segment] " << err << " in: " << segdir << "\n";
+    }
+}
+
 // Load segment stats, docs, and lexicon/index files
-bool load_segment(const fs::path& segdir, Segment& s) {
+bool load_segment(const fs::path& segdir, Segment& s, ThreadPool* pool) {
     s = Segment{};
     s.dir = segdir;
 
+    // Stamped before reading, so a rewrite during the load shows up as a change
+    s.stamp = segment_stamp(segdir);
+
+    // One checksummed segment.seg, or the loose files of older segments
+    std::string err;
+    if (!s.store.open(segdir, err)) {
+        std::cerr << "[segment] rejected " << segdir << ": " << err << "\n";
+        return false;
+    }
+
     // Load stats.bin (N and avgdl)
     {
-        std::ifstream in(segdir / "stats.bin", std::ios::binary);
-        if (!in) return false;
-        s.N = read_u32(in);
-        s.avgdl = read_f32(in);
+        ByteSpan bytes;
+        if (!s.store.get("stats.bin", bytes)) return false;
+        ByteReader in(bytes);
+        s.N = in.u32();
+        s.avgdl = in.f32();
+        if (!in.ok()) return false;
+        s.store.release("stats.bin");
     }
 
     // Load docs.bin document metadata
     {
-        std::ifstream in(segdir / "docs.bin", std::ios::binary);
-        if (!in) return false;
-        uint32_t n = read_u32(in);
-        s.docs.resize(n);
+        ByteSpan bytes;
+        if (!s.store.get("docs.bin", bytes, MapAccess::Sequential)) return false;
+        ByteReader in(bytes);
+        uint32_t n = in.u32();
+        if (!in.ok() || n > in.remaining()) return false;
+        s.doc_lens.resize(n);
+        s.uid_offsets.resize((size_t)n + 1);
+        s.uid_pool.reserve((size_t)n * 8);
 
         // Read per-doc fields (only cord_uid and doc_len are used)
-        for (uint32_t i = 0; i < n; i++) {
-            s.docs[i].cord_uid = read_string(in);
-            read_string(in);  // Skip title (available in metadata.csv)
-            read_string(in);  // Skip json_relpath (available in metadata.csv)
-            s.docs[i].doc_len = read_u32(in);
+        for (uint32_t i = 0; i < n && in.ok(); i++) {
+            s.uid_offsets[i] = (uint32_t)s.uid_pool.size();
+            s.uid_pool += in.str();
+            in.str();  // Skip title (available in metadata.csv)
+            in.str();  // Skip json_relpath (available in metadata.csv)
+            s.doc_lens[i] = in.u32();
+            s.total_len += s.doc_lens[i];
         }
+        s.uid_offsets[n] = (uint32_t)s.uid_pool.size();
+        if (!in.ok()) return false;
+        s.store.release("docs.bin");
     }
 
     // Pick barrel or legacy loader based on segment files
-    if (has_barrels(segdir)) return load_segment_barrels(segdir, s);
-    return load_segment_legacy(segdir, s);
-}
+    bool barrels = s.store.has(seg_file(barrels_manifest_path(segdir))) &&
+                   s.store.has(seg_file(inv_barrel_path(segdir, 0))) &&
+                   s.store.has(seg_file(lex_barrel_path(segdir, 0)));
+    bool ok = barrels ? load_segment_barrels(segdir, s, pool) : load_segment_legacy(s);
+    if (!ok) return false;
 
-// Write barrelized inverted + lexicon files for a single document segment
-void write_barrelized_index_files_single_doc(
-    const fs::path& segdir,
-    const std::vector<std::string>& id_to_term,
-    const std::vector<std::pair<uint32_t, uint32_t>>& fwd
-) {
-    // Setup barrel parameters for term distribution
-    BarrelParams bp;
-    bp.barrel_count = BARREL_COUNT;
-    uint32_t tcount = (uint32_t)id_to_term.size();
-    bp.terms_per_barrel = (tcount + bp.barrel_count - 1) / bp.barrel_count;
-    if (bp.terms_per_barrel == 0) bp.terms_per_barrel = 1;
+    // Optional per-term score bounds (older segments simply lack them)
+    load_term_bounds(segdir, s);
 
-    // Write barrels manifest file
-    write_barrels_manifest(segdir, bp);
+    // Optional block skip entries (block-level seeking and score bounds)
+    load_term_skips(segdir, s);
 
-    // Create output streams for each barrel
-    std::vector<std::ofstream> inv(bp.barrel_count);
-    std::vector<std::ofstream> lex(bp.barrel_count);
-    std::vector<uint64_t> offsets(bp.barrel_count, 0);
-    std::vector<uint32_t> barrel_term_counts(bp.barrel_count, 0);
+    // Optional token positions for phrase queries
+    load_term_positions(segdir, s);
 
-    // Open barrel files and write lex placeholders
-    for (uint32_t b = 0; b < bp.barrel_count; b++) {
-        inv[b].open(inv_barrel_path(segdir, b), std::ios::binary);
-        lex[b].open(lex_barrel_path(segdir, b), std::ios::binary);
-        write_u32(lex[b], 0); // placeholder
-    }
+    // Optional impact-ordered postings
+    load_term_impacts(segdir, s);
 
-    // Build quick tf lookup by termId
-    std::vector<uint32_t> tf_by_tid(tcount, 0);
-    for (auto& [tid, tfv] : fwd) {
-        if (tid < tcount) tf_by_tid[tid] = tfv;
-    }
+    // Sorted terms for prefix scans (autocomplete)
+    load_term_dictionary(segdir, s);
 
-    // Write lexicon and postings into the correct barrel
-    for (uint32_t tid = 0; tid < tcount; tid++) {
-        uint32_t tfv = tf_by_tid[tid];
-        if (tfv == 0) continue;
+    // Term filter for lookups across segments
+    load_term_filter(segdir, s);
 
-        uint32_t b = barrel_for_term(tid, bp);
-        barrel_term_counts[b]++;
+    // cord_uid -> docIds for deletes
+    build_uid_order(s);
+    return true;
+}
 
-        write_string(lex[b], id_to_term[tid]);
-        write_u32(lex[b], tid);
-        write_u32(lex[b], 1); // df
-        write_u64(lex[b], offsets[b]);
-        write_u32(lex[b], 1); // count
+FileStamp file_stamp(const fs::path& path) {
+    FileStamp st;
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec) return st;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return st;
+    st.size = (uint64_t)size;
+    st.mtime = (int64_t)mtime.time_since_epoch().count();
+    st.exists = true;
+    return st;
+}
 
-        // Write single posting (docId=0, tf=tfv)
-        write_u32(inv[b], 0);
-        write_u32(inv[b], tfv);
+// Packed segments are one file; loose ones fold in every file (summed
+// sizes, newest mtime) since tools rewrite them one by one. live.bin is
+// not part of the segment: deletes are picked up without reopening it.
+FileStamp segment_stamp(const fs::path& segdir) {
+    if (has_segment_file(segdir)) return file_stamp(segment_file_path(segdir));
+
+    FileStamp st;
+    std::error_code ec;
+    for (const auto& e : fs::directory_iterator(segdir, ec)) {
+        if (!e.is_regular_file(ec) || e.path() == live_docs_path(segdir)) continue;
+        FileStamp f = file_stamp(e.path());
+        if (!f.exists) continue;
+        st.size += f.size;
+        st.mtime = std::max(st.mtime, f.mtime);
+        st.exists = true;
+    }
+    return st;
+}
+
+// Orders docIds by cord_uid, and against a bare cord_uid for lookups
+struct UidLess {
+    const Segment* s;
+    bool operator()(uint32_t a, uint32_t b) const { return s->cord_uid(a) < s->cord_uid(b); }
+    bool operator()(uint32_t a, std::string_view b) const { return s->cord_uid(a) < b; }
+    bool operator()(std::string_view a, uint32_t b) const { return a < s->cord_uid(b); }
+};
+
+void build_uid_order(Segment& s) {
+    s.uid_order.resize(s.doc_count());
+    for (uint32_t d = 0; d < s.doc_count(); d++) s.uid_order[d] = d;
+    std::sort(s.uid_order.begin(), s.uid_order.end(), UidLess{&s});
+}
 
-        offsets[b] += sizeof(uint32_t) * 2;
+std::pair<const uint32_t*, const uint32_t*> find_uid(const Segment& s, std::string_view cord_uid) {
+    auto range = std::equal_range(s.uid_order.begin(), s.uid_order.end(), cord_uid, UidLess{&s});
+    return {s.uid_order.data() + (range.first - s.uid_order.begin()),
+            s.uid_order.data() + (range.second - s.uid_order.begin())};
+}
+
+// Add a segment's doc count and total length to corpus stats
+void add_segment_stats(CorpusStats& stats, const Segment& s) {
+    stats.N += s.doc_lens.size();
+    stats.total_len += s.total_len;
+    stats.avgdl = stats.N ? (float)((double)stats.total_len / (double)stats.N) : 0.0f;
+}
+
+// Probe each segment's lexicon (a hash lookup in the mapped lexicon.mph),
+// skipping segments whose term filter rules the term out
+bool lookup_term(const std::vector<SegmentPtr>& segments, std::string_view term, TermStats& out) {
+    out.df = 0;
+    out.segs.clear();
+    const uint64_t h = bloom_term_hash(term);
+    for (uint32_t i = 0; i < (uint32_t)segments.size(); i++) {
+        if (!segments[i]->filter.may_contain(h)) continue;
+        const LexEntry* e = segments[i]->lex.find(term);
+        if (!e || e->df == 0) continue;
+        out.df += e->df;
+        out.segs.push_back(TermSegEntry{i, e});
     }
+    return out.df > 0;
+}
 
-    // Patch final term counts into each lex barrel header
-    for (uint32_t b = 0; b < bp.barrel_count; b++) {
-        lex[b].flush();
-        lex[b].close();
+// Write barrelized inverted + lexicon files for a single document segment
+void write_barrelized_index_files_single_doc(
+    const fs::path& segdir,
+    const std::vector<std::string>& id_to_term,
+    const std::vector<std::pair<uint32_t, uint32_t>>& fwd
+) {
+    // Build one-posting lists (docId=0) and the doc length from tf sums
+    uint32_t tcount = (uint32_t)id_to_term.size();
+    std::vector<std::vector<Posting>> inverted(tcount);
+    uint32_t doc_len = 0;
+    for (auto& [tid, tfv] : fwd) {
+        if (tid >= tcount || tfv == 0) continue;
+        inverted[tid].push_back(Posting{0, tfv});
+        doc_len += tfv;
+    }
 
-        std::ofstream patch(lex_barrel_path(segdir, b),
-                            std::ios::binary | std::ios::in | std::ios::out);
-        patch.seekp(0, std::ios::beg);
-        write_u32(patch, barrel_term_counts[b]);
-        patch.flush();
+    std::string err;
+    if (!write_barrelized_index(segdir, id_to_term, inverted, {doc_len}, err)) {
+        std::cerr << "[segment] " << err << ": " << segdir << "\n";
     }
 }
 
@@ -0,0 +1,107 @@
+#include "api_segment_file.hpp"
+
+#include <cstring>
+#include <vector>
+
+#include "segment_file.hpp"
+
+namespace cord19 {
+
+// Postings, positions and forward lists make up nearly all of a segment;
+// open() leaves their checksums to verify_bulk()
+static bool bulk_section(const char* name) {
+    for (const char* prefix : {"inverted", "positions", "impacts", "skips_b", "forward"}) {
+        if (std::strncmp(name, prefix, std::strlen(prefix)) == 0) return true;
+    }
+    return false;
+}
+
+bool SegmentStore::open(const fs::path& segdir, std::string& err) {
+    dir_ = segdir;
+    packed_ = false;
+    container_.close();
+    sections_.clear();
+    bulk_.clear();
+    loose_.clear();
+
+    fs::path path = segment_file_path(segdir);
+    if (!fs::exists(path)) return true;  // loose files (pre-v2 layout)
+
+    if (!container_.open(path, MapAccess::Random)) {
+        err = "cannot map " + path.string();
+        return false;
+    }
+
+    SegmentHeader h;
+    if (container_.size() < sizeof(h)) {
+        err = "file too short for a segment header";
+        return false;
+    }
+    std::memcpy(&h, container_.data(), sizeof(h));
+    if (!check_segment_header(h, container_.size(), err)) return false;
+
+    std::vector<SegmentSection> secs(h.section_count);
+    std::memcpy(secs.data(), container_.data() + h.table_offset, secs.size() * sizeof(SegmentSection));
+    if (!check_segment_table(h, secs, err)) return false;
+
+    // Small sections are checksummed here; the bulk ones wait for verify_bulk()
+    for (const SegmentSection& sec : secs) {
+        ByteSpan bytes = container_.span(sec.offset, sec.size);
+        if (bulk_section(sec.name)) {
+            bulk_.push_back(sec);
+        } else if (crc32_update(0, bytes.data, bytes.size) != sec.crc) {
+            err = std::string("checksum mismatch in ") + sec.name;
+            return false;
+        }
+        sections_[sec.name] = bytes;
+    }
+
+    packed_ = true;
+    return true;
+}
+
+bool SegmentStore::verify_bulk(std::string& err, ThreadPool* pool) const {
+    if (bulk_.empty()) return true;
+
+    // Read front to back once, then back to the queries' scattered reads
+    container_.advise(MapAccess::Sequential);
+    std::vector<char> bad(bulk_.size(), 0);
+    parallel_for(pool, bulk_.size(), [&](size_t i) {
+        ByteSpan bytes = container_.span(bulk_[i].offset, bulk_[i].size);
+        bad[i] = crc32_update(0, bytes.data, bytes.size) != bulk_[i].crc;
+    });
+    container_.advise(MapAccess::Random);
+
+    for (size_t i = 0; i < bulk_.size(); i++) {
+        if (bad[i]) {
+            err = std::string("checksum mismatch in ") + bulk_[i].name;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SegmentStore::has(const std::string& name) const {
+    if (packed_) return sections_.count(name) != 0;
+    return loose_.count(name) != 0 || fs::exists(dir_ / name);
+}
+
+bool SegmentStore::get(const std::string& name, ByteSpan& out, MapAccess access) {
+    if (packed_) {
+        auto it = sections_.find(name);
+        if (it == sections_.end()) return false;
+        out = it->second;
+        return true;
+    }
+
+    auto it = loose_.find(name);
+    if (it == loose_.end()) {
+        MappedFile f;
+        if (!f.open(dir_ / name, access)) return false;
+        it = loose_.emplace(name, std::move(f)).first;
+    }
+    out = it->second.span(0, it->second.size());
+    return true;
+}
+
+} // namespace cord19
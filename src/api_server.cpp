@@ -11,7 +11,9 @@
 #include "api_engine.hpp"
 #include "api_feedback.hpp"
 #include "api_http.hpp"
+#include "api_merge.hpp"
 #include "api_stats.hpp"
+#include "cordjson.hpp"
 #include "env_loader.hpp"
 #include "third_party/httplib.h"
 
@@ -20,8 +22,8 @@ using cord19::json;
 
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cerr << "Usage: api_server <INDEX_DIR> [port]\n"
-                  << "Example: api_server ./index 8080\n";
+        std::cerr << "Usage: api_server <INDEX_DIR> [port] [search_threads] [load_threads]\n"
+                  << "Example: api_server ./index 8080 16 16\n";
         return 1;
     }
 
@@ -31,6 +33,20 @@ int main(int argc, char** argv) {
     int port = 8080;
     if (argc >= 3) port = std::stoi(argv[2]);
 
+    // Search worker pool size (defaults to hardware threads)
+    int search_threads = (int)std::thread::hardware_concurrency();
+    if (argc >= 4) search_threads = std::stoi(argv[3]);
+    if (search_threads < 1) search_threads = 1;
+    engine.set_search_threads((size_t)search_threads);
+    std::cout << "[search] worker threads: " << search_threads << "\n";
+
+    // Reload worker pool size: segments are opened in parallel (defaults to hardware threads)
+    int load_threads = (int)std::thread::hardware_concurrency();
+    if (argc >= 5) load_threads = std::stoi(argv[4]);
+    if (load_threads < 1) load_threads = 1;
+    engine.set_load_threads((size_t)load_threads);
+    std::cout << "[reload] worker threads: " << load_threads << "\n";
+
     if (!engine.reload()) {
         std::cerr << "Failed to load index segments from: " << engine.index_dir << "\n";
         return 1;
@@ -81,6 +97,31 @@ int main(int argc, char** argv) {
         std::cout << "[azure] Azure OpenAI not configured (AI overview endpoint will return error)\n";
     }
 
+    // Optional background segment merging (MERGE_INTERVAL_SECONDS, MERGE_FANOUT)
+    cord19::MergePolicy merge_policy;
+    if (!env_vars["MERGE_FANOUT"].empty()) merge_policy.fanout = (uint32_t)std::stoul(env_vars["MERGE_FANOUT"]);
+    cord19::BackgroundMerger merger(engine.index_dir, merge_policy, [&engine] {
+        // Results cached before the merge name docIds of the replaced segments
+        if (!engine.reload()) return false;
+        engine.clear_search_cache();
+        return true;
+    });
+    if (!env_vars["MERGE_INTERVAL_SECONDS"].empty() && std::stoi(env_vars["MERGE_INTERVAL_SECONDS"]) > 0) {
+        int interval = std::stoi(env_vars["MERGE_INTERVAL_SECONDS"]);
+        merger.start(std::chrono::seconds(interval));
+        std::cout << "[merge] background merging every " << interval << "s, fanout " << merge_policy.fanout << "\n";
+    }
+
+    // Documents added through /api/admin/documents are buffered in memory and
+    // flushed to a segment at RAM_FLUSH_DOCS docs, RAM_FLUSH_MB megabytes or
+    // RAM_FLUSH_SECONDS after the first one, whichever comes first
+    if (!env_vars["RAM_FLUSH_DOCS"].empty()) engine.ram_policy.max_docs = (size_t)std::stoul(env_vars["RAM_FLUSH_DOCS"]);
+    if (!env_vars["RAM_FLUSH_MB"].empty()) engine.ram_policy.max_bytes = (uint64_t)std::stoull(env_vars["RAM_FLUSH_MB"]) << 20;
+    if (!env_vars["RAM_FLUSH_SECONDS"].empty()) engine.ram_policy.max_age = std::chrono::seconds(std::stoi(env_vars["RAM_FLUSH_SECONDS"]));
+    engine.start_ram_flusher(std::chrono::seconds(1));
+    std::cout << "[flush] RAM buffer flushed at " << engine.ram_policy.max_docs << " docs, "
+              << (engine.ram_policy.max_bytes >> 20) << " MB or " << engine.ram_policy.max_age.count() << "s\n";
+
     // Initialize feedback manager with storage in root directory
     cord19::FeedbackManager feedback_manager("feedback.json");
 
@@ -244,7 +285,7 @@ int main(int argc, char** argv) {
         cord19::enable_cors(res);
         json j;
         j["ok"] = true;
-        j["segments"] = (int)engine.segments.size();
+        j["segments"] = (int)engine.snapshot()->segments.size();
         res.set_content(j.dump(2), "application/json");
     });
 
@@ -264,10 +305,48 @@ int main(int argc, char** argv) {
         int k = 10;
         if (req.has_param("k")) k = std::stoi(req.get_param_value("k"));
 
+        // mode=wand (or "pruned") enables top-k pruning, mode=impact scores
+        // quantized impacts; default is exhaustive
+        cord19::SearchMode mode = cord19::SearchMode::Exhaustive;
+        if (req.has_param("mode")) {
+            std::string m = req.get_param_value("mode");
+            if (m == "wand" || m == "pruned") {
+                mode = cord19::SearchMode::Wand;
+            } else if (m == "impact") {
+                mode = cord19::SearchMode::Impact;
+            } else if (m != "exhaustive") {
+                res.status = 400;
+                res.set_content(R"({"error":"mode must be exhaustive, wand or impact"})", "application/json");
+                return;
+            }
+        }
+
+        // offset=N or cursor=<next_cursor> request a later page of the same query
+        size_t offset = 0;
+        std::string cursor;
+        if (req.has_param("offset")) {
+            try {
+                long long o = std::stoll(req.get_param_value("offset"));
+                offset = (size_t)std::max(0LL, o);
+            } catch (...) {
+                res.status = 400;
+                res.set_content(R"({"error":"offset must be a number"})", "application/json");
+                return;
+            }
+        }
+        if (req.has_param("cursor")) cursor = req.get_param_value("cursor");
+
         auto search_t0 = clock::now();
-        auto j = engine.search(q, k);
+        auto j = (offset == 0 && cursor.empty()) ? engine.search(q, k, mode)
+                                                 : engine.search_page(q, k, offset, cursor, mode);
         auto search_t1 = clock::now();
 
+        if (j.contains("error")) {
+            res.status = j.contains("cursor_expired") ? 410 : 400;
+            res.set_content(j.dump(2), "application/json");
+            return;
+        }
+
         double search_ms =
             std::chrono::duration<double, std::milli>(search_t1 - search_t0).count();
         
@@ -340,15 +419,150 @@ int main(int argc, char** argv) {
                  cord19::handle_add_document(engine, req, res, cr);
              });
 
-    svr.Post("/api/reload", [&](const httplib::Request&, httplib::Response& res) {
+    // Delete documents by cord_uid: {"cord_uids": ["..."]}. Re-ingesting a
+    // document and deleting the old copy is how documents are updated.
+    svr.Post("/api/admin/delete", [&](const httplib::Request& req, httplib::Response& res) {
+        cord19::enable_cors(res);
+
+        // Deletes always need an admin token
+        if (!admin_enabled) {
+            res.status = 503;
+            json err;
+            err["error"] = "Admin authentication not configured";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+        if (!cord19::require_admin_auth(req, res, jwt_secret)) return;
+
+        std::vector<std::string> uids;
+        try {
+            json req_body = json::parse(req.body);
+            if (req_body.contains("cord_uid")) uids.push_back(req_body["cord_uid"].get<std::string>());
+            if (req_body.contains("cord_uids")) {
+                for (const auto& u : req_body["cord_uids"]) uids.push_back(u.get<std::string>());
+            }
+        } catch (const std::exception& e) {
+            res.status = 400;
+            json err;
+            err["error"] = "Invalid JSON request body";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+        if (uids.empty()) {
+            res.status = 400;
+            json err;
+            err["error"] = "cord_uids is required";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+
+        size_t deleted = 0;
+        std::string err_msg;
+        json j;
+        if (!engine.delete_documents(uids, deleted, err_msg)) {
+            res.status = 500;
+            j["error"] = err_msg;
+        }
+        j["requested"] = uids.size();
+        j["deleted"] = deleted;
+        j["generation"] = engine.snapshot()->generation;
+        j["ram_epoch"] = engine.snapshot()->ram_epoch;
+        res.set_content(j.dump(2), "application/json");
+    });
+
+    // Add (or replace) one document: {"cord_uid", "title", "text"} or a
+    // CORD-19 parse in "document". It is searchable when the response is sent
+    // and written to a segment by the next RAM flush.
+    svr.Post("/api/admin/documents", [&](const httplib::Request& req, httplib::Response& res) {
         cord19::enable_cors(res);
-        bool ok = engine.reload();
+
+        // Adds always need an admin token
+        if (!admin_enabled) {
+            res.status = 503;
+            json err;
+            err["error"] = "Admin authentication not configured";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+        if (!cord19::require_admin_auth(req, res, jwt_secret)) return;
+
+        std::string uid, title, relpath, text;
+        try {
+            json req_body = json::parse(req.body);
+            uid = req_body.value("cord_uid", "");
+            title = req_body.value("title", "");
+            relpath = req_body.value("json_relpath", "");
+            if (req_body.contains("document")) text = extract_text_from_cord_json(req_body["document"]);
+            else text = req_body.value("text", "");
+        } catch (const std::exception& e) {
+            res.status = 400;
+            json err;
+            err["error"] = "Invalid JSON request body";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+        if (uid.empty() || text.empty()) {
+            res.status = 400;
+            json err;
+            err["error"] = "cord_uid and text (or document) are required";
+            res.set_content(err.dump(2), "application/json");
+            return;
+        }
+
+        size_t replaced = 0;
+        std::string err_msg;
         json j;
-        j["reloaded"] = ok;
-        j["segments"] = (int)engine.segments.size();
+        bool added = engine.add_document(cord19::make_ram_doc(uid, title, relpath, text), replaced, err_msg);
+        if (!added) {
+            res.status = (err_msg == "document has no indexable text") ? 400 : 500;
+            j["error"] = err_msg;
+        }
+        j["added"] = added;
+        j["replaced"] = replaced;
+        j["ram_docs"] = engine.ram_doc_count();
+        j["generation"] = engine.snapshot()->generation;
+        j["ram_epoch"] = engine.snapshot()->ram_epoch;
+        res.set_content(j.dump(2), "application/json");
+    });
+
+    // Reload status plus the snapshot being served
+    auto reload_status_json = [&engine]() {
+        cord19::ReloadStatus st = engine.reload_status();
+        auto snap = engine.snapshot();
+        json j;
+        j["running"] = st.running;
+        j["queued"] = st.queued;
+        j["phase"] = st.phase;
+        j["segments_total"] = st.segments_total;
+        j["segments_done"] = st.segments_done;
+        j["started_at_ms"] = st.started_at_ms;
+        j["last_duration_ms"] = st.last_duration_ms;
+        j["last_ok"] = st.last_ok;
+        j["last_error"] = st.last_error;
+        j["reloads"] = st.reloads;
+        j["failures"] = st.failures;
+        j["generation"] = snap->generation;
+        j["ram_epoch"] = snap->ram_epoch;
+        j["segments"] = (int)snap->segments.size();
+        return j;
+    };
+
+    // Reloads run in the background; searches keep using the current
+    // snapshot until the new one is complete. Poll /api/reload/status.
+    svr.Post("/api/reload", [&](const httplib::Request&, httplib::Response& res) {
+        cord19::enable_cors(res);
+        bool started = engine.reload_async();
+        json j = reload_status_json();
+        j["started"] = started;  // false: queued behind the running reload
+        res.status = 202;
         res.set_content(j.dump(2), "application/json");
     });
 
+    svr.Get("/api/reload/status", [&](const httplib::Request&, httplib::Response& res) {
+        cord19::enable_cors(res);
+        res.set_content(reload_status_json().dump(2), "application/json");
+    });
+
     svr.Get("/api/ai_overview", [&](const httplib::Request& req, httplib::Response& res) {
         cord19::enable_cors(res);
         
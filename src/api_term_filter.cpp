@@ -0,0 +1,36 @@
+#include "api_term_filter.hpp"
+
+#include <cstring>
+
+namespace cord19 {
+
+bool TermFilter::open(ByteSpan bytes, std::string& err) {
+    blocks_ = nullptr;
+    BloomHeader h;
+    if (bytes.size < sizeof(h)) { err = "lexicon.bloom too short"; return false; }
+    std::memcpy(&h, bytes.data, sizeof(h));
+    if (std::memcmp(h.magic, BLOOM_MAGIC, sizeof(BLOOM_MAGIC)) != 0) { err = "lexicon.bloom: bad magic"; return false; }
+    if (h.version != BLOOM_VERSION) { err = "lexicon.bloom: unsupported version " + std::to_string(h.version); return false; }
+    if (h.block_count == 0 || h.block_count > UINT32_MAX || h.hash_count == 0 || h.hash_count > 10) {
+        err = "lexicon.bloom: bad counts";
+        return false;
+    }
+
+    ByteSpan blocks = bytes.sub(sizeof(h), h.block_count * sizeof(uint64_t));
+    if (blocks.empty()) { err = "lexicon.bloom: table out of range"; return false; }
+    if ((uintptr_t)blocks.data % alignof(uint64_t) != 0) { err = "lexicon.bloom: misaligned table"; return false; }
+
+    blocks_ = reinterpret_cast<const uint64_t*>(blocks.data);
+    block_count_ = h.block_count;
+    hash_count_ = h.hash_count;
+    return true;
+}
+
+bool TermFilter::adopt(std::vector<uint8_t> bytes, std::string& err) {
+    owned_ = std::move(bytes);
+    if (open(ByteSpan{owned_.data(), owned_.size()}, err)) return true;
+    owned_.clear();
+    return false;
+}
+
+} // namespace cord19
@@ -6,25 +6,35 @@
 #include <algorithm>
 
 #include "indexio.hpp"
-#include "barrels.hpp"
+#include "barrel_writer.hpp"
+#include "segment_file.hpp"
 
 namespace fs = std::filesystem;
 
-// Posting entry for inverted index
-struct Posting { uint32_t docId; uint32_t tf; };
-
 int main(int argc, char** argv) {
 
-    // Read segment directory from CLI
-    if (argc < 2) {
-        std::cerr << "Usage: lexicon <SEGMENT_DIR>\n";
+    // Read segment directory (and optional "impacts" mode) from CLI
+    if (argc < 2 || (argc > 2 && std::string(argv[2]) != "impacts")) {
+        std::cerr << "Usage: lexicon <SEGMENT_DIR> [impacts]\n";
         return 1;
     }
+    const bool with_impacts = (argc > 2);
 
     // Setup required file paths
     fs::path seg = fs::path(argv[1]);
     fs::path fwd_path  = seg / "forward.bin";
     fs::path term_path = seg / "terms.bin";
+    fs::path docs_path = seg / "docs.bin";
+    fs::path pos_path  = seg / "forward_pos.bin";
+
+    // Rebuilding a packed segment: work on its loose files, repack at the end
+    if (has_segment_file(seg)) {
+        std::string err;
+        if (!unpack_segment(seg, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return 1;
+        }
+    }
 
     // Validate input files exist
     if (!fs::exists(fwd_path) || !fs::exists(term_path)) {
@@ -32,6 +42,26 @@ int main(int argc, char** argv) {
         return 1;
     }
 
+    // Load document lengths (used for per-term score bounds)
+    std::vector<uint32_t> doc_lens;
+    {
+        std::ifstream in(docs_path, std::ios::binary);
+        if (!in) {
+            std::cerr << "Failed to open: " << docs_path << "\n";
+            return 1;
+        }
+
+        uint32_t n = read_u32(in);
+        doc_lens.resize(n);
+
+        for (uint32_t i = 0; i < n; i++) {
+            read_string(in);  // cord_uid
+            read_string(in);  // title
+            read_string(in);  // json_relpath
+            doc_lens[i] = read_u32(in);
+        }
+    }
+
     // Load term dictionary (termId -> term)
     std::vector<std::string> terms;
     {
@@ -48,8 +78,17 @@ int main(int argc, char** argv) {
             terms[i] = read_string(in);
     }
 
-    // Build inverted postings from forward.bin
+    // Token positions are optional (forward_pos.bin parallels forward.bin)
+    std::ifstream pos_in;
+    if (fs::exists(pos_path)) {
+        pos_in.open(pos_path, std::ios::binary);
+        if (!pos_in || read_u32(pos_in) == 0) pos_in.close();
+    }
+    const bool with_positions = pos_in.is_open();
+
+    // Build inverted postings (and per-term positions) from forward.bin
     std::vector<std::vector<Posting>> inverted(terms.size());
+    std::vector<std::vector<uint32_t>> positions(with_positions ? terms.size() : 0);
     {
         std::ifstream in(fwd_path, std::ios::binary);
         if (!in) {
@@ -66,87 +105,55 @@ int main(int argc, char** argv) {
                 uint32_t termId = read_u32(in);
                 uint32_t tf     = read_u32(in);
 
+                // Positions are stored for every forward entry, so always consume them
+                if (with_positions) {
+                    for (uint32_t k = 0; k < tf; k++) {
+                        uint32_t p = read_u32(pos_in);
+                        if (termId < positions.size()) positions[termId].push_back(p);
+                    }
+                }
+
                 if (termId >= inverted.size()) continue;
                 inverted[termId].push_back(Posting{docId, tf});
             }
         }
     }
 
+    if (with_positions && !pos_in) {
+        std::cerr << "Truncated: " << pos_path << "\n";
+        return 1;
+    }
+
     // Write barrelized lexicon and inverted files
     {
-        BarrelParams bp;
-        bp.barrel_count = BARREL_COUNT;
-        uint32_t tcount = (uint32_t)terms.size();
-        bp.terms_per_barrel = (tcount + bp.barrel_count - 1) / bp.barrel_count;
-        if (bp.terms_per_barrel == 0) bp.terms_per_barrel = 1;
-
-        write_barrels_manifest(seg, bp);
-
-        std::vector<std::ofstream> inv(bp.barrel_count);
-        std::vector<std::ofstream> lex(bp.barrel_count);
-        std::vector<uint64_t> offsets(bp.barrel_count, 0);
-        std::vector<uint32_t> barrel_term_counts(bp.barrel_count, 0);
-
-        // Open barrel output files
-        for (uint32_t b = 0; b < bp.barrel_count; b++) {
-            inv[b].open(inv_barrel_path(seg, b), std::ios::binary);
-            lex[b].open(lex_barrel_path(seg, b), std::ios::binary);
-
-            if (!inv[b] || !lex[b]) {
-                std::cerr << "Failed to open barrel files in: " << seg << "\n";
-                return 1;
-            }
-
-            write_u32(lex[b], 0);
+        std::string err;
+        if (!write_barrelized_index(seg, terms, inverted, doc_lens, err,
+                                    with_positions ? &positions : nullptr)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return 1;
         }
+    }
 
-        // Write postings and lex entries per term
-        for (uint32_t tid = 0; tid < tcount; tid++) {
-            auto& plist = inverted[tid];
-            if (plist.empty()) continue;
-
-            std::sort(plist.begin(), plist.end(),
-                      [](const Posting& a, const Posting& b) { return a.docId < b.docId; });
-
-            uint32_t df = (uint32_t)plist.size();
-            uint32_t b  = barrel_for_term(tid, bp);
-
-            barrel_term_counts[b]++;
-
-            write_string(lex[b], terms[tid]);
-            write_u32(lex[b], tid);
-            write_u32(lex[b], df);
-            write_u64(lex[b], offsets[b]);
-            write_u32(lex[b], df);
-
-            for (auto& p : plist) {
-                write_u32(inv[b], p.docId);
-                write_u32(inv[b], p.tf);
-            }
-
-            offsets[b] += (uint64_t)df * (sizeof(uint32_t) * 2);
+    // Optional impact-ordered postings (quantized BM25, for mode=impact)
+    if (with_impacts) {
+        std::string err;
+        if (!write_impact_index(seg, inverted, doc_lens, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return 1;
         }
+    }
 
-        // Patch header counts in each lex barrel file
-        for (uint32_t b = 0; b < bp.barrel_count; b++) {
-            lex[b].flush();
-            lex[b].close();
-
-            std::ofstream patch(
-                lex_barrel_path(seg, b),
-                std::ios::in | std::ios::out | std::ios::binary
-            );
-            if (!patch) {
-                std::cerr << "Failed to patch lexicon barrel: " << lex_barrel_path(seg, b) << "\n";
-                return 1;
-            }
-
-            patch.seekp(0, std::ios::beg);
-            write_u32(patch, barrel_term_counts[b]);
-            patch.flush();
+    // Pack everything into one checksummed segment.seg
+    {
+        std::string err;
+        if (!pack_segment(seg, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return 1;
         }
     }
 
-    std::cerr << "Built BARRELIZED lexicon+inverted in: " << seg << "\n";
+    std::cerr << "Built BARRELIZED lexicon+inverted"
+              << (with_positions ? "+positions" : "")
+              << (with_impacts ? "+impacts" : "") << " in: " << seg << "\n";
     return 0;
 }
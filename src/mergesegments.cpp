@@ -0,0 +1,51 @@
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "api_merge.hpp"
+#include "api_segment.hpp"
+
+namespace fs = std::filesystem;
+
+int main(int argc, char** argv) {
+
+    // Read index directory and optional fanout (or "all") from CLI
+    if (argc < 2 || argc > 3) {
+        std::cerr << "Usage: mergesegments <INDEX_DIR> [fanout|all]\n"
+                  << "  fanout: segments per merge, default 10 (tiered merge policy)\n"
+                  << "  all:    merge every segment into one\n";
+        return 1;
+    }
+    fs::path index_dir = fs::path(argv[1]);
+    cord19::MergePolicy policy;
+    bool all = false;
+    if (argc > 2) {
+        std::string arg = argv[2];
+        if (arg == "all") all = true;
+        else policy.fanout = (uint32_t)std::stoul(arg);
+    }
+
+    size_t before = cord19::list_segments(index_dir).size();
+
+    // Merge until the policy is satisfied; replaced segments are deleted as
+    // soon as the manifest no longer lists them
+    size_t merges = 0;
+    while (true) {
+        std::vector<std::string> replaced;
+        std::string err;
+        if (!cord19::merge_index_step(index_dir, policy, all, replaced, err)) {
+            std::cerr << err << " in: " << index_dir << "\n";
+            return 1;
+        }
+        if (replaced.empty()) break;
+        cord19::remove_segments(index_dir, replaced);
+        merges++;
+        if (all) break;
+    }
+
+    std::cerr << "Merged " << merges << " times: " << before << " -> "
+              << cord19::list_segments(index_dir).size() << " segments in: " << index_dir << "\n";
+    if (merges > 0) std::cerr << "A running api_server picks this up on POST /api/reload\n";
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "barrels.hpp"
+#include "segment_file.hpp"
+
+namespace fs = std::filesystem;
+
+// Print per-barrel postings sizes and how far each is from an even split
+static bool report_barrels(const fs::path& seg) {
+    std::string err;
+    std::vector<char> manifest;
+    BarrelParams bp;
+    if (!read_segment_bytes(seg, barrels_manifest_path({}).string(), manifest, err) ||
+        !parse_barrels_manifest((const uint8_t*)manifest.data(), manifest.size(), bp)) {
+        std::cerr << "No barrel manifest in: " << seg << (err.empty() ? "" : " (" + err + ")") << "\n";
+        return false;
+    }
+
+    std::vector<SegmentSection> files;
+    if (!list_segment_files(seg, files, err)) {
+        std::cerr << err << " in: " << seg << "\n";
+        return false;
+    }
+    std::map<std::string, uint64_t> sizes;
+    for (const auto& f : files) sizes[f.name] = f.size;
+
+    std::vector<uint64_t> inv(bp.barrel_count), pos(bp.barrel_count);
+    uint64_t total = 0, largest = 0;
+    uint32_t empty = 0;
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        inv[b] = sizes[inv_barrel_path({}, b).string()];
+        pos[b] = sizes[pos_barrel_path({}, b).string()];
+        total += inv[b];
+        largest = std::max(largest, inv[b]);
+        if (inv[b] == 0) empty++;
+    }
+    double mean = bp.barrel_count ? (double)total / bp.barrel_count : 0.0;
+
+    std::cout << seg.string() << ": " << bp.barrel_count << " barrels, "
+              << (bp.first_term.empty() ? "equal termId ranges" : "size-balanced") << "\n";
+    std::cout << "  barrel  first_term   postings_bytes  positions_bytes   share   x_mean\n";
+    for (uint32_t b = 0; b < bp.barrel_count; b++) {
+        uint64_t first = bp.first_term.empty() ? (uint64_t)b * bp.terms_per_barrel : bp.first_term[b];
+        std::cout << "  " << std::setw(6) << b << "  " << std::setw(10) << first << "  "
+                  << std::setw(15) << inv[b] << "  " << std::setw(15) << pos[b] << "  "
+                  << std::fixed << std::setprecision(2)
+                  << std::setw(6) << (total ? 100.0 * inv[b] / total : 0.0) << "%  "
+                  << std::setw(7) << (mean > 0 ? inv[b] / mean : 0.0) << "\n";
+    }
+    std::cout << "  total " << total << " bytes, largest/mean "
+              << std::setprecision(2) << (mean > 0 ? largest / mean : 0.0)
+              << ", empty barrels " << empty << "\n";
+    std::cout.unsetf(std::ios::fixed);
+    return true;
+}
+
+// Run one command on one segment directory
+static bool run(const std::string& cmd, const fs::path& seg, bool list_sections) {
+    std::string err;
+
+    if (cmd == "convert") {
+        // Repack an already packed segment from its loose files
+        if (has_segment_file(seg) && !unpack_segment(seg, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return false;
+        }
+        if (!pack_segment(seg, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return false;
+        }
+        std::cerr << "Packed: " << seg << "\n";
+        return true;
+    }
+
+    if (cmd == "unpack") {
+        if (!has_segment_file(seg)) {
+            std::cerr << "Not packed, nothing to do: " << seg << "\n";
+            return true;
+        }
+        if (!unpack_segment(seg, err)) {
+            std::cerr << err << " in: " << seg << "\n";
+            return false;
+        }
+        std::cerr << "Unpacked: " << seg << "\n";
+        return true;
+    }
+
+    if (cmd == "barrels") return report_barrels(seg);
+
+    // verify
+    if (!has_segment_file(seg)) {
+        std::cerr << "Loose (pre-v2) segment, no checksums: " << seg << "\n";
+        return true;
+    }
+    std::vector<SegmentSection> secs;
+    if (!verify_segment_file(seg, err, &secs)) {
+        std::cerr << "CORRUPT " << seg << ": " << err << "\n";
+        return false;
+    }
+    std::cout << seg.string() << ": OK, " << secs.size() << " sections\n";
+    if (!list_sections) return true;
+    for (const auto& s : secs)
+        std::cout << "  " << s.name << "  " << s.size << " bytes @ " << s.offset << "\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+
+    // Read command and segment (or index) directory from CLI
+    std::string cmd = (argc == 3) ? argv[1] : "";
+    if (cmd != "convert" && cmd != "verify" && cmd != "unpack" && cmd != "barrels") {
+        std::cerr << "Usage: segtool <convert|verify|unpack|barrels> <SEGMENT_DIR|INDEX_DIR>\n";
+        return 1;
+    }
+
+    // An index directory applies the command to each of its segments
+    fs::path dir = fs::path(argv[2]);
+    std::vector<fs::path> segs;
+    if (fs::is_directory(dir / "segments")) {
+        for (const auto& e : fs::directory_iterator(dir / "segments"))
+            if (e.is_directory()) segs.push_back(e.path());
+        std::sort(segs.begin(), segs.end());
+    } else {
+        segs.push_back(dir);
+    }
+
+    bool ok = true;
+    for (const auto& seg : segs) ok = run(cmd, seg, segs.size() == 1) && ok;
+    return ok ? 0 : 1;
+}
@@ -33,7 +33,7 @@ const float* SemanticIndex::get_vec_ptr(const std::string& term) const {
 
 // Load embeddings from text file for selected terms
 bool SemanticIndex::load_from_text(const fs::path& path,
-                                  const std::unordered_set<std::string>& needed_terms) {
+                                  const std::function<bool(const std::string&)>& needed) {
     enabled = false;
     dim = 0;
     terms.clear();
@@ -73,7 +73,7 @@ bool SemanticIndex::load_from_text(const fs::path& path,
         if (!(iss >> word)) continue;
 
         // Filter to needed terms only
-        if (!needed_terms.empty() && needed_terms.find(word) == needed_terms.end()) {
+        if (needed && !needed(word)) {
             continue;
         }
 